@@ -0,0 +1,415 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+/*
+ * Hybrid analogue of Set: AVL tree, whose nodes hold sorted buckets of up to BucketSize keys.
+ * Buckets split when they overflow and merge with the next one when they become sparse, so tree
+ * has about BucketSize times fewer nodes, allocations and rotations, and range scans mostly read
+ * consecutive memory.
+ * Template type must have operator <.
+ * It supports standard set operations in O(log(tree_size) + BucketSize):
+ * - insert
+ * - erase
+ * - find
+ * - lower_bound
+ */
+template<class T, size_t BucketSize = 32>
+class BucketSet {
+    static_assert(BucketSize >= 4, "BucketSet: bucket must hold at least 4 keys");
+
+  public:
+    BucketSet() = default;
+
+    BucketSet(const BucketSet& other) {
+        for (const T& val : other) {
+            insert(val);
+        }
+    }
+
+    // Assignment operator
+    BucketSet& operator=(const BucketSet& other) {
+        if (&other == this) {
+            return *this;
+        }
+        destroy(root->left);
+        root->left = nullptr;
+        element_count = 0;
+        for (const T& val : other) {
+            insert(val);
+        }
+        return *this;
+    }
+
+    BucketSet(const std::initializer_list<T>& elems) {
+        for (const T& val : elems) {
+            insert(val);
+        }
+    }
+
+    template<typename Iterator>
+    BucketSet(const Iterator first, const Iterator last) {
+        for (Iterator it = first; it != last; ++it) {
+            insert(*it);
+        }
+    }
+
+    class iterator;
+
+    // If needed value exists, returns iterator on it, otherwise end().
+    iterator find(const T& val) const {
+        iterator it = lower_bound(val);
+        return it == end() || val < *it ? end() : it;
+    }
+
+    // Returns iterator on the lowest key >= val.
+    iterator lower_bound(const T& val) const {
+        Node* cur = root->left;
+        Node* ans = root;
+        while (cur) {
+            if (cur->keys[cur->count - 1] < val) {
+                cur = cur->right;
+            } else {
+                ans = cur;
+                cur = cur->left;
+            }
+        }
+        return iterator(ans, static_cast<uint32_t>(ans->position(val)));
+    }
+
+    iterator begin() const {
+        Node* ans = root;
+        while (ans->left) {
+            ans = ans->left;
+        }
+        return iterator(ans, 0);
+    }
+
+    iterator end() const { return iterator(root, 0); }
+
+    // Inserts element in tree. If such exists, does nothing.
+    void insert(const T& val) {
+        if (root->left == nullptr) {
+            Node* node = new Node();
+            node->keys[0] = val;
+            node->count = 1;
+            node->height = 0;
+            node->parent = root;
+            root->left = node;
+            ++element_count;
+            return;
+        }
+        Node* node = find_bucket(val);
+        size_t pos = node->position(val);
+        if (pos < node->count && !(val < node->keys[pos])) {
+            return;
+        }
+        ++element_count;
+        if (node->count < BucketSize) {
+            node->insert_at(pos, val);
+            return;
+        }
+        // Bucket is full: upper half goes to new node, which becomes next bucket in order.
+        Node* next = new Node();
+        std::move(node->keys + BucketSize / 2, node->keys + BucketSize, next->keys);
+        next->count = BucketSize - BucketSize / 2;
+        node->count = BucketSize / 2;
+        if (pos <= node->count) {
+            node->insert_at(pos, val);
+        } else {
+            next->insert_at(pos - node->count, val);
+        }
+        next->height = 0;
+        if (node->right == nullptr) {
+            node->right = next;
+            next->parent = node;
+        } else {
+            Node* parent = get_leftest_node(node->right);
+            parent->left = next;
+            next->parent = parent;
+        }
+        rebalance_upward(next->parent);
+    }
+
+    // Erases element from tree. If such doesn't exist, does nothing.
+    void erase(const T& val) {
+        if (root->left == nullptr) {
+            return;
+        }
+        Node* node = find_bucket(val);
+        size_t pos = node->position(val);
+        if (pos == node->count || val < node->keys[pos]) {
+            return;
+        }
+        --element_count;
+        node->erase_at(pos);
+        if (node->count == 0) {
+            remove_node(node);
+            return;
+        }
+        // Sparse bucket absorbs the next one, if they fit together with some room left.
+        Node* next = get_next_node(node);
+        if (node->count < BucketSize / 4 && next != root && node->count + next->count <= BucketSize * 3 / 4) {
+            std::move(next->keys, next->keys + next->count, node->keys + node->count);
+            node->count += next->count;
+            next->count = 0;
+            remove_node(next);
+        }
+    }
+
+    size_t size() const { return element_count; }
+
+    bool empty() const { return element_count == 0; }
+
+    ~BucketSet() { destroy(root->left); }
+
+  private:
+    // Auxiliary class for storing node's information.
+    struct Node {
+        static constexpr int32_t UNDEFINED = -1;
+        Node* parent = nullptr;
+        Node* left = nullptr;
+        Node* right = nullptr;
+        int32_t height = UNDEFINED;
+        uint32_t count = 0;
+        T keys[BucketSize];
+
+        // Index of the lowest key >= val in bucket.
+        size_t position(const T& val) const { return std::lower_bound(keys, keys + count, val) - keys; }
+
+        void insert_at(size_t pos, const T& val) {
+            std::move_backward(keys + pos, keys + count, keys + count + 1);
+            keys[pos] = val;
+            ++count;
+        }
+
+        void erase_at(size_t pos) {
+            std::move(keys + pos + 1, keys + count, keys + pos);
+            --count;
+        }
+    };
+
+  public:
+    /*
+     * Bidirectional iterator over keys of buckets
+     * Doesn't support random access
+     * Prefix/postfix increment/decrement works in amortized O(1)
+     * */
+    class iterator {
+      public:
+        iterator() = default;
+
+        iterator(Node* node_, uint32_t index_) : node(node_), index(index_) {}
+
+        bool operator==(const iterator& it) const { return it.node == node && it.index == index; }
+
+        bool operator!=(const iterator& it) const { return !(*this == it); }
+
+        T operator*() const { return node->keys[index]; }
+
+        const T* operator->() const { return &node->keys[index]; }
+
+        iterator& operator++() {
+            if (++index == node->count) {
+                node = get_next_node(node);
+                index = 0;
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        iterator& operator--() {
+            if (index == 0) {
+                node = get_prev_node(node);
+                index = node->count;
+            }
+            --index;
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+
+      private:
+        Node* node = nullptr;
+        uint32_t index = 0;
+    };
+
+  private:
+    static Node* get_leftest_node(Node* node) {
+        while (node->left != nullptr) {
+            node = node->left;
+        }
+        return node;
+    }
+
+    static Node* get_rightest_node(Node* node) {
+        while (node->right != nullptr) {
+            node = node->right;
+        }
+        return node;
+    }
+
+    // Auxiliary method for finding next node in tree. Returns sentinel after the last one.
+    static Node* get_next_node(Node* node) {
+        if (node->right != nullptr) {
+            return get_leftest_node(node->right);
+        }
+        while (node->parent->right == node) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+
+    // Auxiliary method for finding previous node in tree. Sentinel is followed by the last one.
+    static Node* get_prev_node(Node* node) {
+        if (node->left != nullptr) {
+            return get_rightest_node(node->left);
+        }
+        while (node->parent->left == node) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+
+    // Descends to bucket, which val belongs to: its range contains val, or val falls next to it.
+    Node* find_bucket(const T& val) const {
+        Node* cur = root->left;
+        while (true) {
+            if (val < cur->keys[0] && cur->left != nullptr) {
+                cur = cur->left;
+            } else if (cur->keys[cur->count - 1] < val && cur->right != nullptr) {
+                cur = cur->right;
+            } else {
+                return cur;
+            }
+        }
+    }
+
+    // Auxiliary function for deleting tree and releasing memory.
+    void destroy(Node* node) {
+        if (node == nullptr) {
+            return;
+        }
+        destroy(node->left);
+        destroy(node->right);
+        delete node;
+    }
+
+    // Unlinks node from tree and deletes it. Node with two children trades its bucket with the next node.
+    void remove_node(Node* node) {
+        if (node->left && node->right) {
+            Node* next = get_leftest_node(node->right);
+            std::swap(node->keys, next->keys);
+            std::swap(node->count, next->count);
+            node = next;
+        }
+        Node* child = node->left ? node->left : node->right;
+        Node* parent = node->parent;
+        if (parent->left == node) {
+            parent->left = child;
+        } else {
+            parent->right = child;
+        }
+        if (child) {
+            child->parent = parent;
+        }
+        delete node;
+        rebalance_upward(parent);
+    }
+
+    int32_t get_height(Node* node) { return node == nullptr ? Node::UNDEFINED : node->height; }
+
+    int32_t height_difference(Node* node) {
+        return node ? get_height(node->left) - get_height(node->right) : 0;
+    }
+
+    void update_height(Node* node) {
+        node->height = 1 + std::max(get_height(node->left), get_height(node->right));
+    }
+
+    Node* left_rotate(Node* node) {
+        Node* temp = node->right;
+        node->right = temp->left;
+        if (temp->left) {
+            temp->left->parent = node;
+        }
+        temp->left = node;
+        temp->parent = node->parent;
+        node->parent = temp;
+        update_height(node);
+        update_height(temp);
+        return temp;
+    }
+
+    Node* right_rotate(Node* node) {
+        Node* temp = node->left;
+        node->left = temp->right;
+        if (temp->right) {
+            temp->right->parent = node;
+        }
+        temp->right = node;
+        temp->parent = node->parent;
+        node->parent = temp;
+        update_height(node);
+        update_height(temp);
+        return temp;
+    }
+
+    // Standard AVL's rotate implementation.
+    Node* rotate(Node* node) {
+        int32_t n_diff = height_difference(node);
+        if (n_diff == -TWO) {
+            if (height_difference(node->right) == ONE) {
+                node->right = right_rotate(node->right);
+            }
+            node = left_rotate(node);
+        } else if (n_diff == TWO) {
+            if (height_difference(node->left) == -ONE) {
+                node->left = left_rotate(node->left);
+            }
+            node = right_rotate(node);
+        }
+        return node;
+    }
+
+    // Fixes heights and rotates on the path from node up. Stops once subtree height is unchanged.
+    void rebalance_upward(Node* node) {
+        while (node != root) {
+            Node* parent = node->parent;
+            int32_t old_height = node->height;
+            update_height(node);
+            Node* top = rotate(node);
+            if (top != node) {
+                if (parent->left == node) {
+                    parent->left = top;
+                } else {
+                    parent->right = top;
+                }
+            }
+            if (top->height == old_height) {
+                return;
+            }
+            node = parent;
+        }
+    }
+
+    size_t element_count = 0;
+    // Invariant of root!=null is needed for always having node, representing end() iterator.
+    Node sentinel;
+    Node* root = &sentinel;
+    static constexpr int32_t ONE = 1;
+    static constexpr int32_t TWO = 2;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+#include "Set.h"
+
+/*
+ * Set for contended writers by flat combining. Thread publishes its request in a slot and waits, while
+ * whichever thread takes the combiner role applies all pending requests in one batch. So the tree and
+ * the lock stay in cache of one core at a time, instead of moving between cores on each operation.
+ * Batch is sorted by key and applied by finger search from the previous position, so nearby keys
+ * share descent paths.
+ * Template type must have operator <.
+ * Operations may be called from any number of threads; they are linearizable:
+ * - insert
+ * - erase
+ * - contains
+ * Each takes O(log(tree_size)), or less for close keys of one batch, plus waiting for the combiner.
+ */
+template<class T>
+class CombiningSet {
+  public:
+    CombiningSet() = default;
+
+    CombiningSet(const CombiningSet&) = delete;
+
+    CombiningSet& operator=(const CombiningSet&) = delete;
+
+    CombiningSet(const std::initializer_list<T>& elems) {
+        for (const T& val : elems) {
+            insert(val);
+        }
+    }
+
+    bool contains(const T& val) { return execute(CONTAINS, val); }
+
+    // Inserts element in tree. If such exists, does nothing.
+    void insert(const T& val) { execute(INSERT, val); }
+
+    // Erases element from tree. If such doesn't exist, does nothing.
+    void erase(const T& val) { execute(ERASE, val); }
+
+    // Requests and batches, applied by combiners so far.
+    struct CombiningStats {
+        uint64_t requests = 0;
+        uint64_t batches = 0;
+    };
+
+    // Must not be called concurrently with operations.
+    CombiningStats combining_stats() const { return stats; }
+
+    // Underlying set. Must not be used concurrently with operations.
+    const Set<T>& set() const { return keys; }
+
+  private:
+    enum Operation : uint32_t { IDLE, INSERT, ERASE, CONTAINS };
+
+    // Slot of one waiting thread. Combiner resets op to IDLE, once request is applied.
+    struct alignas(64) Slot {
+        std::atomic<bool> taken{false};
+        std::atomic<uint32_t> op{IDLE};
+        const T* value = nullptr;
+        bool result = false;
+    };
+
+    bool execute(Operation op, const T& val) {
+        Slot& slot = take_slot();
+        slot.value = &val;
+        slot.op.store(op, std::memory_order_release);
+        for (int spins = 0; slot.op.load(std::memory_order_acquire) != IDLE; ++spins) {
+            if (!combining.load(std::memory_order_relaxed) && !combining.exchange(true, std::memory_order_acquire)) {
+                combine();
+                combining.store(false, std::memory_order_release);
+            } else if (spins >= SPINS) {
+                std::this_thread::yield();
+            }
+        }
+        bool result = slot.result;
+        slot.taken.store(false, std::memory_order_release);
+        return result;
+    }
+
+    Slot& take_slot() {
+        // Threads get increasing hints, so slots in use stay packed at the beginning, and combiner
+        // scans only them.
+        static std::atomic<size_t> next_hint{0};
+        static thread_local size_t hint = next_hint.fetch_add(1) % SLOTS;
+        for (size_t i = hint;; ++i) {
+            size_t index = i % SLOTS;
+            Slot& slot = slots[index];
+            if (!slot.taken.load(std::memory_order_relaxed) && !slot.taken.exchange(true, std::memory_order_acquire)) {
+                size_t used = used_slots.load(std::memory_order_relaxed);
+                while (used <= index && !used_slots.compare_exchange_weak(used, index + 1)) {
+                }
+                return slot;
+            }
+            if ((i + 1) % SLOTS == hint) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Runs by the thread, which took combining flag.
+    void combine() {
+        batch.clear();
+        size_t used = used_slots.load();
+        for (size_t i = 0; i < used; ++i) {
+            if (slots[i].op.load(std::memory_order_acquire) != IDLE) {
+                batch.push_back(&slots[i]);
+            }
+        }
+        std::sort(batch.begin(), batch.end(), [](const Slot* a, const Slot* b) { return *a->value < *b->value; });
+        typename Set<T>::iterator hint = keys.begin();
+        for (Slot* slot : batch) {
+            const T& val = *slot->value;
+            switch (slot->op.load(std::memory_order_relaxed)) {
+                case INSERT:
+                    hint = keys.insert(hint, val);
+                    break;
+                case ERASE:
+                    hint = keys.lower_bound(hint, val);
+                    if (hint != keys.end() && !(val < *hint)) {
+                        hint = keys.erase(hint);
+                    }
+                    break;
+                default:
+                    hint = keys.lower_bound(hint, val);
+                    slot->result = hint != keys.end() && !(val < *hint);
+                    break;
+            }
+            slot->op.store(IDLE, std::memory_order_release);
+        }
+        stats.requests += batch.size();
+        ++stats.batches;
+    }
+
+    static constexpr size_t SLOTS = 128;
+    static constexpr int SPINS = 64;
+    Slot slots[SLOTS];
+    // Slots with greater indices were never taken.
+    std::atomic<size_t> used_slots{0};
+    alignas(64) std::atomic<bool> combining{false};
+    // Fields below are used only by combiner.
+    Set<T> keys;
+    std::vector<Slot*> batch;
+    CombiningStats stats;
+};
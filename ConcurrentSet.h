@@ -0,0 +1,984 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Lock for short critical sections. Waiter spins for a while and then yields to other threads.
+class SetSpinLock {
+  public:
+    void lock() {
+        while (locked.exchange(true, std::memory_order_acquire)) {
+            for (int spins = 0; locked.load(std::memory_order_relaxed); ++spins) {
+                if (spins >= SPINS) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    void unlock() { locked.store(false, std::memory_order_release); }
+
+  private:
+    std::atomic<bool> locked{false};
+    static constexpr int SPINS = 64;
+};
+
+/*
+ * Epoch-based reclamation of nodes, unlinked from concurrent tree, which other threads may still read.
+ * Each operation runs under Guard, which pins the current epoch in one of slots. Retired node is freed,
+ * once epoch has advanced twice: by then no operation, which could have reached it, is running.
+ */
+template<class Node>
+class SetEpochs {
+    struct Retired {
+        Node* node;
+        uint64_t epoch;
+    };
+
+    // Slot is taken by one operation at a time. Its retired nodes wait there for any later owner to free them.
+    struct alignas(64) Slot {
+        std::atomic<bool> taken{false};
+        std::atomic<uint64_t> pinned{IDLE};
+        std::vector<Retired> retired;
+    };
+
+  public:
+    SetEpochs() = default;
+
+    SetEpochs(const SetEpochs&) = delete;
+
+    SetEpochs& operator=(const SetEpochs&) = delete;
+
+    class Guard {
+      public:
+        explicit Guard(SetEpochs& epochs_) : epochs(epochs_), slot(epochs_.pin()) {}
+
+        Guard(const Guard&) = delete;
+
+        Guard& operator=(const Guard&) = delete;
+
+        // Node must be already unreachable for operations, starting later.
+        void retire(Node* node) {
+            slot.retired.push_back(Retired{node, epochs.epoch.load()});
+            if (slot.retired.size() >= COLLECT_BATCH) {
+                epochs.collect(slot);
+            }
+        }
+
+        ~Guard() { epochs.unpin(slot); }
+
+      private:
+        SetEpochs& epochs;
+        Slot& slot;
+    };
+
+    ~SetEpochs() {
+        for (Slot& slot : slots) {
+            for (const Retired& retired : slot.retired) {
+                delete retired.node;
+            }
+        }
+    }
+
+  private:
+    Slot& pin() {
+        // Threads start from different slots and keep the last one, so they rarely compete for it.
+        static thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t i = hint;; ++i) {
+            Slot& slot = slots[i % SLOTS];
+            if (!slot.taken.load(std::memory_order_relaxed) && !slot.taken.exchange(true, std::memory_order_acquire)) {
+                hint = i % SLOTS;
+                uint64_t current;
+                do {
+                    current = epoch.load();
+                    slot.pinned.store(current);
+                } while (epoch.load() != current);
+                return slot;
+            }
+            if ((i + 1) % SLOTS == hint) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unpin(Slot& slot) {
+        slot.pinned.store(IDLE, std::memory_order_release);
+        slot.taken.store(false, std::memory_order_release);
+    }
+
+    // Advances epoch, if all running operations have seen the current one, and frees nodes of the slot,
+    // retired two epochs ago.
+    void collect(Slot& slot) {
+        uint64_t current = epoch.load();
+        bool quiescent = true;
+        for (const Slot& other : slots) {
+            uint64_t pinned = other.pinned.load();
+            if (pinned != IDLE && pinned != current) {
+                quiescent = false;
+                break;
+            }
+        }
+        if (quiescent) {
+            epoch.compare_exchange_strong(current, current + 1);
+        }
+        uint64_t safe = epoch.load();
+        size_t kept = 0;
+        for (const Retired& retired : slot.retired) {
+            if (retired.epoch + 2 <= safe) {
+                delete retired.node;
+            } else {
+                slot.retired[kept++] = retired;
+            }
+        }
+        slot.retired.resize(kept);
+    }
+
+    static constexpr uint64_t IDLE = ~uint64_t(0);
+    static constexpr size_t SLOTS = 128;
+    static constexpr size_t COLLECT_BATCH = 64;
+    std::atomic<uint64_t> epoch{0};
+    Slot slots[SLOTS];
+};
+
+/*
+ * Concurrent analogue of Set: optimistic AVL tree of Bronson, Casper, Chafi and Olukotun.
+ * Readers take no locks: they validate each step against version number of the node, which changes
+ * whenever its subtree may lose keys. Writers lock only the nodes they change, so updates on disjoint
+ * paths don't wait for each other; concurrent_scaling() in the bench measures how that scales with cores.
+ * Erased key of node with two children leaves it in the tree as routing node, which is unlinked later,
+ * when it has at most one child. Unlinked nodes are freed by epochs.
+ * Template type must have operator < and be default constructible.
+ * It supports following operations in O(log(tree_size)) without contention, all linearizable:
+ * - insert
+ * - erase
+ * - contains
+ * - lower_bound
+ */
+template<class T>
+class ConcurrentSet {
+  public:
+    ConcurrentSet() = default;
+
+    ConcurrentSet(const ConcurrentSet&) = delete;
+
+    ConcurrentSet& operator=(const ConcurrentSet&) = delete;
+
+    ConcurrentSet(const std::initializer_list<T>& elems) {
+        for (const T& val : elems) {
+            insert(val);
+        }
+    }
+
+    bool contains(const T& val) const {
+        Guard guard(epochs);
+        while (true) {
+            Node* right = holder.right.load();
+            if (right == nullptr) {
+                return false;
+            }
+            bool go_left = val < right->key;
+            if (!go_left && !(right->key < val)) {
+                return right->present();
+            }
+            uint64_t version = right->version.load();
+            if (is_shrinking_or_unlinked(version)) {
+                right->wait_until_changed(version);
+            } else if (right == holder.right.load()) {
+                int result = attempt_get(val, right, go_left, version);
+                if (result != RETRY) {
+                    return result == FOUND;
+                }
+            }
+        }
+    }
+
+    /*
+     * Finds the lowest key >= val and writes it to result. Returns false, if there is no such key.
+     * Nodes, read on the way, are validated all together in the end, so the answer was correct
+     * at one moment.
+     */
+    bool lower_bound(const T& val, T& result) const {
+        Guard guard(epochs);
+        Scratch& scratch = lower_bound_scratch();
+        while (true) {
+            int outcome = attempt_lower_bound(val, result, scratch);
+            if (outcome != RETRY) {
+                return outcome == FOUND;
+            }
+        }
+    }
+
+    // Inserts element in tree. Returns false, if such exists.
+    bool insert(const T& val) { return update(val, true); }
+
+    // Erases element from tree. Returns false, if such doesn't exist.
+    bool erase(const T& val) { return update(val, false); }
+
+    // Counts keys in O(tree_size). It is exact only without concurrent updates.
+    size_t size() const {
+        Guard guard(epochs);
+        size_t count = 0;
+        std::vector<const Node*> stack;
+        for (const Node* node = holder.right.load(); node != nullptr || !stack.empty(); ) {
+            if (node == nullptr) {
+                node = stack.back();
+                stack.pop_back();
+            }
+            count += node->present();
+            if (Node* right = node->right.load()) {
+                stack.push_back(right);
+            }
+            node = node->left.load();
+        }
+        return count;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    ~ConcurrentSet() {
+        std::vector<Node*> stack;
+        if (Node* root = holder.right.load()) {
+            stack.push_back(root);
+        }
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            if (Node* left = node->left.load()) {
+                stack.push_back(left);
+            }
+            if (Node* right = node->right.load()) {
+                stack.push_back(right);
+            }
+            delete node;
+        }
+    }
+
+  private:
+    /*
+     * Version number of node: flags of changes in progress and counters of finished ones.
+     * Shrink is a rotation, after which some keys of the subtree are not in it any more, grow is
+     * linking of new leaf. Unlinked node keeps UNLINKED forever.
+     */
+    static constexpr uint64_t UNLINKED = 1;
+    static constexpr uint64_t GROWING = 2;
+    static constexpr uint64_t SHRINKING = 4;
+    static constexpr uint64_t GROW_COUNT_INCR = 1 << 3;
+    static constexpr uint64_t GROW_COUNT_MASK = uint64_t(0xff) << 3;
+    static constexpr uint64_t SHRINK_COUNT_INCR = 1 << 11;
+    static constexpr uint64_t IGNORE_GROW = ~(GROWING | GROW_COUNT_MASK);
+
+    static bool is_shrinking_or_unlinked(uint64_t version) { return (version & (SHRINKING | UNLINKED)) != 0; }
+
+    static bool is_changing_or_unlinked(uint64_t version) {
+        return (version & (SHRINKING | GROWING | UNLINKED)) != 0;
+    }
+
+    static bool is_unlinked(uint64_t version) { return (version & UNLINKED) != 0; }
+
+    // Whether traversal, validated by orig version, must be retried. Growth doesn't remove keys from subtree.
+    static bool has_shrunk_or_unlinked(uint64_t orig, uint64_t current) { return ((orig ^ current) & IGNORE_GROW) != 0; }
+
+    // Auxiliary class for storing node's information. Height of null is 0.
+    struct Node {
+        const T key;
+        std::atomic<uint64_t> version{0};
+        std::atomic<int32_t> height{1};
+        // Odd while key is present, even for routing node. Changes under lock.
+        std::atomic<uint32_t> state{1};
+        std::atomic<Node*> parent{nullptr};
+        std::atomic<Node*> left{nullptr};
+        std::atomic<Node*> right{nullptr};
+        SetSpinLock lock;
+
+        Node() : key() {}
+
+        Node(const T& val, Node* parent_) : key(val), parent(parent_) {}
+
+        bool present() const { return (state.load() & 1) != 0; }
+
+        void set_present(bool present_) {
+            if (present() != present_) {
+                state.fetch_add(1);
+            }
+        }
+
+        Node* child(bool is_left) const { return is_left ? left.load() : right.load(); }
+
+        void set_child(bool is_left, Node* node) {
+            if (is_left) {
+                left.store(node);
+            } else {
+                right.store(node);
+            }
+        }
+
+        // Waits for the change of subtree, marked in version, to complete: spins a bit, then blocks on the lock.
+        void wait_until_changed(uint64_t orig) {
+            if ((orig & (SHRINKING | GROWING)) == 0) {
+                return;
+            }
+            for (int spins = 0; spins < WAIT_SPINS; ++spins) {
+                if (version.load() != orig) {
+                    return;
+                }
+            }
+            std::lock_guard<SetSpinLock> guard(lock);
+        }
+    };
+
+    using Epochs = SetEpochs<Node>;
+    using Guard = typename Epochs::Guard;
+
+    // Node, read by lower_bound(), with its version and state at that moment.
+    struct Visit {
+        const Node* node;
+        uint64_t version;
+        uint32_t state;
+    };
+
+    // Buffers of lower_bound(), reused between calls of the thread.
+    struct Scratch {
+        std::vector<Visit> visits;
+        // Indices of visits, where search went left: in-order successors of current position, the nearest last.
+        std::vector<size_t> pending;
+    };
+
+    static Scratch& lower_bound_scratch() {
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+
+    static int32_t height(const Node* node) { return node == nullptr ? 0 : node->height.load(); }
+
+    // Results of recursive attempts. RETRY makes the caller revalidate its own step and try again.
+    static constexpr int RETRY = 0;
+    static constexpr int FOUND = 1;
+    static constexpr int NOT_FOUND = 2;
+    static constexpr int CHANGED = 1;
+    static constexpr int UNCHANGED = 2;
+
+    // Searches val in subtree of child of node, which was reached, when node had node_version.
+    int attempt_get(const T& val, Node* node, bool go_left, uint64_t node_version) const {
+        while (true) {
+            Node* child = node->child(go_left);
+            if (child == nullptr) {
+                // Child was read, while node was still the place for val, so val was absent at that moment.
+                return has_shrunk_or_unlinked(node_version, node->version.load()) ? RETRY : NOT_FOUND;
+            }
+            bool child_left = val < child->key;
+            if (!child_left && !(child->key < val)) {
+                return child->present() ? FOUND : NOT_FOUND;
+            }
+            uint64_t child_version = child->version.load();
+            if (is_shrinking_or_unlinked(child_version)) {
+                child->wait_until_changed(child_version);
+                if (has_shrunk_or_unlinked(node_version, node->version.load())) {
+                    return RETRY;
+                }
+            } else if (child != node->child(go_left)) {
+                // Link to child is protected by child_version only, if it is read after it.
+                if (has_shrunk_or_unlinked(node_version, node->version.load())) {
+                    return RETRY;
+                }
+            } else {
+                if (has_shrunk_or_unlinked(node_version, node->version.load())) {
+                    return RETRY;
+                }
+                // Step to child is valid, further steps are validated by child_version.
+                int result = attempt_get(val, child, child_left, child_version);
+                if (result != RETRY) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    // Reads version and state of node before its links. Returns false, if node is being changed.
+    static bool visit(const Node* node, Scratch& scratch) {
+        uint64_t version = node->version.load();
+        if (is_changing_or_unlinked(version)) {
+            const_cast<Node*>(node)->wait_until_changed(version);
+            return false;
+        }
+        scratch.visits.push_back(Visit{node, version, node->state.load()});
+        return true;
+    }
+
+    // Reads link of visited node and visits the child, if any. Returns false, if the child is being changed
+    // or has moved: link to child is protected by version of child only, if it is still there after it.
+    static bool visit_child(const Node* node, bool is_left, Scratch& scratch, const Node*& child) {
+        child = node->child(is_left);
+        return child == nullptr || (visit(child, scratch) && node->child(is_left) == child);
+    }
+
+    /*
+     * Descends to position of val and walks in order past routing nodes to the first present key.
+     * If none of visited nodes has changed since it was read, the visited part of the tree was exactly
+     * as seen at the moment, when validation starts: every change of links is marked in version of
+     * changed node or of its visited ancestor.
+     */
+    int attempt_lower_bound(const T& val, T& result, Scratch& scratch) const {
+        scratch.visits.clear();
+        scratch.pending.clear();
+        if (!visit(&holder, scratch)) {
+            return RETRY;
+        }
+        size_t next = NONE;
+        const Node* node;
+        if (!visit_child(&holder, false, scratch, node)) {
+            return RETRY;
+        }
+        while (node != nullptr) {
+            bool go_left = val < node->key;
+            if (go_left) {
+                scratch.pending.push_back(scratch.visits.size() - 1);
+            } else if (!(node->key < val)) {
+                next = scratch.visits.size() - 1;
+                break;
+            }
+            const Node* child;
+            if (!visit_child(node, go_left, scratch, child)) {
+                return RETRY;
+            }
+            node = child;
+        }
+        if (next == NONE) {
+            next = pop_pending(scratch);
+        }
+        while (next != NONE && (scratch.visits[next].state & 1) == 0) {
+            // Successors of routing node are the leftmost path of its right subtree.
+            bool is_left = false;
+            for (node = scratch.visits[next].node;; is_left = true) {
+                const Node* child;
+                if (!visit_child(node, is_left, scratch, child)) {
+                    return RETRY;
+                }
+                if (child == nullptr) {
+                    break;
+                }
+                scratch.pending.push_back(scratch.visits.size() - 1);
+                node = child;
+            }
+            next = pop_pending(scratch);
+        }
+        for (const Visit& seen : scratch.visits) {
+            if (seen.node->version.load() != seen.version || seen.node->state.load() != seen.state) {
+                return RETRY;
+            }
+        }
+        if (next == NONE) {
+            return NOT_FOUND;
+        }
+        result = scratch.visits[next].node->key;
+        return FOUND;
+    }
+
+    static size_t pop_pending(Scratch& scratch) {
+        if (scratch.pending.empty()) {
+            return NONE;
+        }
+        size_t index = scratch.pending.back();
+        scratch.pending.pop_back();
+        return index;
+    }
+
+    bool update(const T& val, bool insert) {
+        Guard guard(epochs);
+        while (true) {
+            Node* right = holder.right.load();
+            if (right == nullptr) {
+                if (!insert) {
+                    return false;
+                }
+                if (attempt_insert_into_empty(val)) {
+                    return true;
+                }
+            } else {
+                uint64_t version = right->version.load();
+                if (is_shrinking_or_unlinked(version)) {
+                    right->wait_until_changed(version);
+                } else if (right == holder.right.load()) {
+                    int result = attempt_update(val, insert, &holder, right, version, guard);
+                    if (result != RETRY) {
+                        return result == CHANGED;
+                    }
+                }
+            }
+        }
+    }
+
+    bool attempt_insert_into_empty(const T& val) {
+        std::lock_guard<SetSpinLock> lock(holder.lock);
+        if (holder.right.load() != nullptr) {
+            return false;
+        }
+        uint64_t version = holder.version.load();
+        holder.version.store(version | GROWING);
+        holder.right.store(new Node(val, &holder));
+        holder.version.store(version + GROW_COUNT_INCR);
+        return true;
+    }
+
+    // Updates val in subtree of node, which was reached from parent, when node had node_version.
+    int attempt_update(const T& val, bool insert, Node* parent, Node* node, uint64_t node_version, Guard& guard) {
+        bool go_left = val < node->key;
+        if (!go_left && !(node->key < val)) {
+            return attempt_node_update(insert, parent, node, guard);
+        }
+        while (true) {
+            Node* child = node->child(go_left);
+            if (has_shrunk_or_unlinked(node_version, node->version.load())) {
+                return RETRY;
+            }
+            if (child == nullptr) {
+                if (!insert) {
+                    return UNCHANGED;
+                }
+                Node* damaged;
+                {
+                    std::lock_guard<SetSpinLock> lock(node->lock);
+                    // Under lock no rotation can move node, so it stays the place for val.
+                    if (has_shrunk_or_unlinked(node_version, node->version.load())) {
+                        return RETRY;
+                    }
+                    if (node->child(go_left) != nullptr) {
+                        // Lost the race with concurrent insert.
+                        continue;
+                    }
+                    uint64_t version = node->version.load();
+                    node->version.store(version | GROWING);
+                    node->set_child(go_left, new Node(val, node));
+                    node->version.store(version + GROW_COUNT_INCR);
+                    damaged = fix_height_locked(node);
+                }
+                fix_height_and_rebalance(damaged, guard);
+                return CHANGED;
+            }
+            uint64_t child_version = child->version.load();
+            if (is_shrinking_or_unlinked(child_version)) {
+                child->wait_until_changed(child_version);
+            } else if (child == node->child(go_left)) {
+                if (has_shrunk_or_unlinked(node_version, node->version.load())) {
+                    return RETRY;
+                }
+                int result = attempt_update(val, insert, node, child, child_version, guard);
+                if (result != RETRY) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    // Parent is used only for unlinking, so update of key may proceed, even if it is stale.
+    int attempt_node_update(bool insert, Node* parent, Node* node, Guard& guard) {
+        if (insert || (node->present() && node->left.load() != nullptr && node->right.load() != nullptr)) {
+            std::lock_guard<SetSpinLock> lock(node->lock);
+            if (is_unlinked(node->version.load())) {
+                return RETRY;
+            }
+            if (node->present() == insert) {
+                return UNCHANGED;
+            }
+            // Node, which lost a child meanwhile, must be unlinked instead.
+            if (!insert && (node->left.load() == nullptr || node->right.load() == nullptr)) {
+                return RETRY;
+            }
+            node->set_present(insert);
+            return CHANGED;
+        }
+        if (!node->present()) {
+            return UNCHANGED;
+        }
+        Node* damaged;
+        {
+            std::lock_guard<SetSpinLock> parent_lock(parent->lock);
+            if (is_unlinked(parent->version.load()) || node->parent.load() != parent) {
+                return RETRY;
+            }
+            std::lock_guard<SetSpinLock> lock(node->lock);
+            if (!node->present()) {
+                return UNCHANGED;
+            }
+            if (!attempt_unlink_locked(parent, node)) {
+                return RETRY;
+            }
+            damaged = fix_height_locked(parent);
+        }
+        guard.retire(node);
+        fix_height_and_rebalance(damaged, guard);
+        return CHANGED;
+    }
+
+    // Splices out node with at most one child. Both must be locked. Heights are not fixed.
+    bool attempt_unlink_locked(Node* parent, Node* node) {
+        Node* parent_left = parent->left.load();
+        if (parent_left != node && parent->right.load() != node) {
+            return false;
+        }
+        Node* left = node->left.load();
+        Node* right = node->right.load();
+        if (left != nullptr && right != nullptr) {
+            return false;
+        }
+        Node* splice = left != nullptr ? left : right;
+        parent->set_child(parent_left == node, splice);
+        if (splice != nullptr) {
+            splice->parent.store(parent);
+        }
+        node->version.store(UNLINKED);
+        node->set_present(false);
+        return true;
+    }
+
+    static constexpr int32_t UNLINK_REQUIRED = -1;
+    static constexpr int32_t REBALANCE_REQUIRED = -2;
+    static constexpr int32_t NOTHING_REQUIRED = -3;
+
+    // Returns new height of node, if only it must be fixed, or one of the conditions above.
+    // Read is not atomic, but thread, which damages node later, is responsible for fixing it.
+    static int32_t node_condition(Node* node) {
+        Node* left = node->left.load();
+        Node* right = node->right.load();
+        if ((left == nullptr || right == nullptr) && !node->present()) {
+            return UNLINK_REQUIRED;
+        }
+        int32_t height_node = node->height.load();
+        int32_t height_left = height(left);
+        int32_t height_right = height(right);
+        int32_t new_height = 1 + std::max(height_left, height_right);
+        int32_t balance = height_left - height_right;
+        if (balance < -1 || balance > 1) {
+            return REBALANCE_REQUIRED;
+        }
+        return height_node != new_height ? new_height : NOTHING_REQUIRED;
+    }
+
+    // Fixes damaged nodes bottom-up, until there is nothing to fix. When rebalancing leaves damage below,
+    // the nodes above it are revisited in the end, so their heights are fixed too.
+    void fix_height_and_rebalance(Node* node, Guard& guard) {
+        static thread_local std::vector<Node*> revisit;
+        revisit.clear();
+        while (true) {
+            int32_t condition = NOTHING_REQUIRED;
+            if (node != nullptr && node->parent.load() != nullptr && !is_unlinked(node->version.load())) {
+                condition = node_condition(node);
+            }
+            if (condition == NOTHING_REQUIRED) {
+                if (revisit.empty()) {
+                    return;
+                }
+                node = revisit.back();
+                revisit.pop_back();
+            } else if (condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED) {
+                std::lock_guard<SetSpinLock> lock(node->lock);
+                node = fix_height_locked(node);
+            } else {
+                Node* parent = node->parent.load();
+                std::lock_guard<SetSpinLock> parent_lock(parent->lock);
+                if (!is_unlinked(parent->version.load()) && node->parent.load() == parent) {
+                    std::lock_guard<SetSpinLock> lock(node->lock);
+                    node = rebalance_locked(parent, node, guard, revisit);
+                    if (node != nullptr && node != parent && parent != &holder) {
+                        revisit.push_back(parent);
+                    }
+                }
+            }
+        }
+    }
+
+    // Fixes height of locked node. Returns the next damaged node, this thread is responsible for, or null.
+    static Node* fix_height_locked(Node* node) {
+        int32_t condition = node_condition(node);
+        switch (condition) {
+            case REBALANCE_REQUIRED:
+            case UNLINK_REQUIRED:
+                return node;
+            case NOTHING_REQUIRED:
+                return nullptr;
+            default:
+                node->height.store(condition);
+                return node->parent.load();
+        }
+    }
+
+    // Parent and node must be locked. Returns damaged node or null.
+    Node* rebalance_locked(Node* parent, Node* node, Guard& guard, std::vector<Node*>& revisit) {
+        Node* left = node->left.load();
+        Node* right = node->right.load();
+        if ((left == nullptr || right == nullptr) && !node->present()) {
+            if (attempt_unlink_locked(parent, node)) {
+                guard.retire(node);
+                return fix_height_locked(parent);
+            }
+            return node;
+        }
+        int32_t height_node = node->height.load();
+        int32_t height_left = height(left);
+        int32_t height_right = height(right);
+        int32_t new_height = 1 + std::max(height_left, height_right);
+        int32_t balance = height_left - height_right;
+        if (balance > 1) {
+            return rebalance_to_right(parent, node, left, height_right, revisit);
+        }
+        if (balance < -1) {
+            return rebalance_to_left(parent, node, right, height_left, revisit);
+        }
+        if (new_height != height_node) {
+            node->height.store(new_height);
+            return fix_height_locked(parent);
+        }
+        return nullptr;
+    }
+
+    // Left subtree is too high: rotates right, first rotating left the left child, if needed.
+    Node* rebalance_to_right(Node* parent, Node* node, Node* left, int32_t height_right, std::vector<Node*>& revisit) {
+        std::lock_guard<SetSpinLock> left_lock(left->lock);
+        int32_t height_left = left->height.load();
+        if (height_left - height_right <= 1) {
+            return node;
+        }
+        Node* left_right = left->right.load();
+        int32_t height_left_left = height(left->left.load());
+        int32_t height_left_right = height(left_right);
+        if (height_left_left >= height_left_right) {
+            return rotate_right(parent, node, left, height_right, height_left_left, left_right, height_left_right);
+        }
+        {
+            std::lock_guard<SetSpinLock> left_right_lock(left_right->lock);
+            height_left_right = left_right->height.load();
+            if (height_left_left >= height_left_right) {
+                return rotate_right(parent, node, left, height_right, height_left_left, left_right, height_left_right);
+            }
+            // Double rotation is done only, if it leaves left child balanced and not an unneeded routing node.
+            int32_t height_left_right_left = height(left_right->left.load());
+            int32_t balance = height_left_left - height_left_right_left;
+            if (balance >= -1 && balance <= 1 &&
+                !((height_left_left == 0 || height_left_right_left == 0) && !left->present())) {
+                return rotate_right_over_left(parent, node, left, height_right, height_left_left, left_right,
+                                              height_left_right_left);
+            }
+            // Otherwise left child is rotated on its own, and node is rebalanced later.
+            revisit.push_back(node);
+            Node* left_right_left = left_right->left.load();
+            return rotate_left(node, left, height_left_left, left_right, left_right_left, height(left_right_left),
+                               height(left_right->right.load()));
+        }
+    }
+
+    Node* rebalance_to_left(Node* parent, Node* node, Node* right, int32_t height_left, std::vector<Node*>& revisit) {
+        std::lock_guard<SetSpinLock> right_lock(right->lock);
+        int32_t height_right = right->height.load();
+        if (height_left - height_right >= -1) {
+            return node;
+        }
+        Node* right_left = right->left.load();
+        int32_t height_right_left = height(right_left);
+        int32_t height_right_right = height(right->right.load());
+        if (height_right_right >= height_right_left) {
+            return rotate_left(parent, node, height_left, right, right_left, height_right_left, height_right_right);
+        }
+        {
+            std::lock_guard<SetSpinLock> right_left_lock(right_left->lock);
+            height_right_left = right_left->height.load();
+            if (height_right_right >= height_right_left) {
+                return rotate_left(parent, node, height_left, right, right_left, height_right_left, height_right_right);
+            }
+            int32_t height_right_left_right = height(right_left->right.load());
+            int32_t balance = height_right_right - height_right_left_right;
+            if (balance >= -1 && balance <= 1 &&
+                !((height_right_right == 0 || height_right_left_right == 0) && !right->present())) {
+                return rotate_left_over_right(parent, node, height_left, right, right_left, height_right_right,
+                                              height_right_left_right);
+            }
+            revisit.push_back(node);
+            Node* right_left_right = right_left->right.load();
+            return rotate_right(node, right, right_left, height_right_right, height(right_left->left.load()),
+                                right_left_right, height(right_left_right));
+        }
+    }
+
+    /*
+     * Rotations mark shrinking nodes in their versions, while links change. Links are changed in order,
+     * in which concurrent readers never miss a key. Each returns the deepest node, which still needs fixing,
+     * or fixes height of parent, if nothing else is damaged.
+     */
+    Node* rotate_right(Node* parent, Node* node, Node* left, int32_t height_right, int32_t height_left_left,
+                       Node* left_right, int32_t height_left_right) {
+        uint64_t version = node->version.load();
+        Node* parent_left = parent->left.load();
+        node->version.store(version | SHRINKING);
+        node->left.store(left_right);
+        if (left_right != nullptr) {
+            left_right->parent.store(node);
+        }
+        left->right.store(node);
+        node->parent.store(left);
+        parent->set_child(parent_left == node, left);
+        left->parent.store(parent);
+        int32_t new_height = 1 + std::max(height_left_right, height_right);
+        node->height.store(new_height);
+        left->height.store(1 + std::max(height_left_left, new_height));
+        node->version.store(version + SHRINK_COUNT_INCR);
+
+        int32_t balance_node = height_left_right - height_right;
+        if (balance_node < -1 || balance_node > 1) {
+            return node;
+        }
+        if ((left_right == nullptr || height_right == 0) && !node->present()) {
+            return node;
+        }
+        int32_t balance_left = height_left_left - new_height;
+        if (balance_left < -1 || balance_left > 1) {
+            return left;
+        }
+        if (height_left_left == 0 && !left->present()) {
+            return left;
+        }
+        return fix_height_locked(parent);
+    }
+
+    Node* rotate_left(Node* parent, Node* node, int32_t height_left, Node* right, Node* right_left,
+                      int32_t height_right_left, int32_t height_right_right) {
+        uint64_t version = node->version.load();
+        Node* parent_left = parent->left.load();
+        node->version.store(version | SHRINKING);
+        node->right.store(right_left);
+        if (right_left != nullptr) {
+            right_left->parent.store(node);
+        }
+        right->left.store(node);
+        node->parent.store(right);
+        parent->set_child(parent_left == node, right);
+        right->parent.store(parent);
+        int32_t new_height = 1 + std::max(height_left, height_right_left);
+        node->height.store(new_height);
+        right->height.store(1 + std::max(new_height, height_right_right));
+        node->version.store(version + SHRINK_COUNT_INCR);
+
+        int32_t balance_node = height_right_left - height_left;
+        if (balance_node < -1 || balance_node > 1) {
+            return node;
+        }
+        if ((right_left == nullptr || height_left == 0) && !node->present()) {
+            return node;
+        }
+        int32_t balance_right = height_right_right - new_height;
+        if (balance_right < -1 || balance_right > 1) {
+            return right;
+        }
+        if (height_right_right == 0 && !right->present()) {
+            return right;
+        }
+        return fix_height_locked(parent);
+    }
+
+    Node* rotate_right_over_left(Node* parent, Node* node, Node* left, int32_t height_right, int32_t height_left_left,
+                                 Node* left_right, int32_t height_left_right_left) {
+        uint64_t version = node->version.load();
+        uint64_t left_version = left->version.load();
+        Node* parent_left = parent->left.load();
+        Node* left_right_left = left_right->left.load();
+        Node* left_right_right = left_right->right.load();
+        int32_t height_left_right_right = height(left_right_right);
+
+        node->version.store(version | SHRINKING);
+        left->version.store(left_version | SHRINKING);
+        node->left.store(left_right_right);
+        if (left_right_right != nullptr) {
+            left_right_right->parent.store(node);
+        }
+        left->right.store(left_right_left);
+        if (left_right_left != nullptr) {
+            left_right_left->parent.store(left);
+        }
+        left_right->left.store(left);
+        left->parent.store(left_right);
+        left_right->right.store(node);
+        node->parent.store(left_right);
+        parent->set_child(parent_left == node, left_right);
+        left_right->parent.store(parent);
+
+        int32_t new_height = 1 + std::max(height_left_right_right, height_right);
+        node->height.store(new_height);
+        int32_t new_left_height = 1 + std::max(height_left_left, height_left_right_left);
+        left->height.store(new_left_height);
+        left_right->height.store(1 + std::max(new_left_height, new_height));
+        node->version.store(version + SHRINK_COUNT_INCR);
+        left->version.store(left_version + SHRINK_COUNT_INCR);
+
+        int32_t balance_node = height_left_right_right - height_right;
+        if (balance_node < -1 || balance_node > 1) {
+            return node;
+        }
+        if ((left_right_right == nullptr || height_right == 0) && !node->present()) {
+            return node;
+        }
+        int32_t balance_left_right = new_left_height - new_height;
+        if (balance_left_right < -1 || balance_left_right > 1) {
+            return left_right;
+        }
+        return fix_height_locked(parent);
+    }
+
+    Node* rotate_left_over_right(Node* parent, Node* node, int32_t height_left, Node* right, Node* right_left,
+                                 int32_t height_right_right, int32_t height_right_left_right) {
+        uint64_t version = node->version.load();
+        uint64_t right_version = right->version.load();
+        Node* parent_left = parent->left.load();
+        Node* right_left_left = right_left->left.load();
+        Node* right_left_right = right_left->right.load();
+        int32_t height_right_left_left = height(right_left_left);
+
+        node->version.store(version | SHRINKING);
+        right->version.store(right_version | SHRINKING);
+        node->right.store(right_left_left);
+        if (right_left_left != nullptr) {
+            right_left_left->parent.store(node);
+        }
+        right->left.store(right_left_right);
+        if (right_left_right != nullptr) {
+            right_left_right->parent.store(right);
+        }
+        right_left->right.store(right);
+        right->parent.store(right_left);
+        right_left->left.store(node);
+        node->parent.store(right_left);
+        parent->set_child(parent_left == node, right_left);
+        right_left->parent.store(parent);
+
+        int32_t new_height = 1 + std::max(height_left, height_right_left_left);
+        node->height.store(new_height);
+        int32_t new_right_height = 1 + std::max(height_right_left_right, height_right_right);
+        right->height.store(new_right_height);
+        right_left->height.store(1 + std::max(new_height, new_right_height));
+        node->version.store(version + SHRINK_COUNT_INCR);
+        right->version.store(right_version + SHRINK_COUNT_INCR);
+
+        int32_t balance_node = height_right_left_left - height_left;
+        if (balance_node < -1 || balance_node > 1) {
+            return node;
+        }
+        if ((right_left_left == nullptr || height_left == 0) && !node->present()) {
+            return node;
+        }
+        int32_t balance_right_left = new_right_height - new_height;
+        if (balance_right_left < -1 || balance_right_left > 1) {
+            return right_left;
+        }
+        return fix_height_locked(parent);
+    }
+
+    static constexpr size_t NONE = ~size_t(0);
+    static constexpr int WAIT_SPINS = 100;
+    // Holder of the tree: its right child is root. It is never rotated or unlinked.
+    mutable Node holder;
+    mutable Epochs epochs;
+};
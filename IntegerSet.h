@@ -0,0 +1,430 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "Set.h"
+
+/*
+ * van Emde Boas tree over keys of Bits bits.
+ * Minimum of node isn't stored in its clusters, so every non-empty node owns at least one key
+ * and memory is linear in number of keys. Clusters are kept in hash table.
+ * Every operation descends into at most one child per level: O(log(Bits)).
+ */
+template<unsigned Bits>
+class VebNode {
+  public:
+    bool empty() const { return is_empty; }
+
+    uint64_t min() const { return min_key; }
+
+    uint64_t max() const { return max_key; }
+
+    bool contains(uint64_t x) const {
+        if (is_empty) {
+            return false;
+        }
+        if (x == min_key || x == max_key) {
+            return true;
+        }
+        auto it = clusters.find(high(x));
+        return it != clusters.end() && it->second.contains(low(x));
+    }
+
+    // Returns false, if key already exists.
+    bool insert(uint64_t x) {
+        if (is_empty) {
+            min_key = max_key = x;
+            is_empty = false;
+            return true;
+        }
+        if (x == min_key) {
+            return false;
+        }
+        if (x < min_key) {
+            std::swap(x, min_key);
+        }
+        uint64_t h = high(x);
+        auto it = clusters.find(h);
+        bool inserted = true;
+        if (it == clusters.end()) {
+            if (!summary) {
+                summary.reset(new Child());
+            }
+            summary->insert(h);
+            clusters[h].insert(low(x));
+        } else {
+            inserted = it->second.insert(low(x));
+        }
+        if (max_key < x) {
+            max_key = x;
+        }
+        return inserted;
+    }
+
+    // Returns false, if key doesn't exist.
+    bool erase(uint64_t x) {
+        if (is_empty) {
+            return false;
+        }
+        if (min_key == max_key) {
+            if (x != min_key) {
+                return false;
+            }
+            is_empty = true;
+            return true;
+        }
+        if (x == min_key) {
+            // The lowest key of clusters becomes minimum and is erased from its cluster.
+            uint64_t h = summary->min();
+            x = index(h, clusters.find(h)->second.min());
+            min_key = x;
+        }
+        uint64_t h = high(x);
+        auto it = clusters.find(h);
+        if (it == clusters.end() || !it->second.erase(low(x))) {
+            return false;
+        }
+        if (it->second.empty()) {
+            clusters.erase(it);
+            summary->erase(h);
+        }
+        if (x == max_key) {
+            if (clusters.empty()) {
+                max_key = min_key;
+            } else {
+                uint64_t last = summary->max();
+                max_key = index(last, clusters.find(last)->second.max());
+            }
+        }
+        if (clusters.empty()) {
+            summary.reset();
+        }
+        return true;
+    }
+
+    // Finds the lowest key >= x.
+    bool lower_bound(uint64_t x, uint64_t& ans) const {
+        if (is_empty || max_key < x) {
+            return false;
+        }
+        if (x <= min_key) {
+            ans = min_key;
+            return true;
+        }
+        uint64_t h = high(x);
+        auto it = clusters.find(h);
+        uint64_t l = 0;
+        if (it != clusters.end() && it->second.lower_bound(low(x), l)) {
+            ans = index(h, l);
+            return true;
+        }
+        // Answer exists, as x <= max, so it is minimum of the next cluster.
+        uint64_t next = 0;
+        summary->lower_bound(h + 1, next);
+        ans = index(next, clusters.find(next)->second.min());
+        return true;
+    }
+
+    // Finds the highest key <= x.
+    bool prev(uint64_t x, uint64_t& ans) const {
+        if (is_empty || x < min_key) {
+            return false;
+        }
+        if (max_key <= x) {
+            ans = max_key;
+            return true;
+        }
+        uint64_t h = high(x);
+        auto it = clusters.find(h);
+        uint64_t l = 0;
+        if (it != clusters.end() && it->second.prev(low(x), l)) {
+            ans = index(h, l);
+            return true;
+        }
+        uint64_t before = 0;
+        if (h == 0 || !summary->prev(h - 1, before)) {
+            ans = min_key;
+            return true;
+        }
+        ans = index(before, clusters.find(before)->second.max());
+        return true;
+    }
+
+  private:
+    using Child = VebNode<Bits / 2>;
+    static constexpr unsigned LOW_BITS = Bits / 2;
+
+    static uint64_t high(uint64_t x) { return x >> LOW_BITS; }
+
+    static uint64_t low(uint64_t x) { return x & ((uint64_t(1) << LOW_BITS) - 1); }
+
+    static uint64_t index(uint64_t h, uint64_t l) { return h << LOW_BITS | l; }
+
+    uint64_t min_key = 0;
+    uint64_t max_key = 0;
+    bool is_empty = true;
+    // Set of non-empty clusters. Created only when node holds more than one key.
+    std::unique_ptr<Child> summary;
+    std::unordered_map<uint64_t, Child> clusters;
+};
+
+// Leaf of van Emde Boas tree: plain bitmap of 256 keys.
+template<>
+class VebNode<8> {
+  public:
+    bool empty() const { return (words[0] | words[1] | words[2] | words[3]) == 0; }
+
+    uint64_t min() const {
+        uint64_t ans = 0;
+        lower_bound(0, ans);
+        return ans;
+    }
+
+    uint64_t max() const {
+        uint64_t ans = 0;
+        prev(LAST, ans);
+        return ans;
+    }
+
+    bool contains(uint64_t x) const { return words[x / WORD] >> (x % WORD) & 1; }
+
+    bool insert(uint64_t x) {
+        uint64_t bit = uint64_t(1) << (x % WORD);
+        if (words[x / WORD] & bit) {
+            return false;
+        }
+        words[x / WORD] |= bit;
+        return true;
+    }
+
+    bool erase(uint64_t x) {
+        uint64_t bit = uint64_t(1) << (x % WORD);
+        if (!(words[x / WORD] & bit)) {
+            return false;
+        }
+        words[x / WORD] &= ~bit;
+        return true;
+    }
+
+    bool lower_bound(uint64_t x, uint64_t& ans) const {
+        size_t i = x / WORD;
+        uint64_t word = words[i] & (~uint64_t(0) << (x % WORD));
+        while (word == 0) {
+            if (++i == WORDS) {
+                return false;
+            }
+            word = words[i];
+        }
+        ans = i * WORD + __builtin_ctzll(word);
+        return true;
+    }
+
+    bool prev(uint64_t x, uint64_t& ans) const {
+        size_t i = x / WORD;
+        uint64_t word = words[i] & (~uint64_t(0) >> (WORD - 1 - x % WORD));
+        while (word == 0) {
+            if (i == 0) {
+                return false;
+            }
+            word = words[--i];
+        }
+        ans = i * WORD + WORD - 1 - __builtin_clzll(word);
+        return true;
+    }
+
+  private:
+    static constexpr size_t WORD = 64;
+    static constexpr size_t WORDS = 4;
+    static constexpr uint64_t LAST = 255;
+    uint64_t words[WORDS] = {};
+};
+
+/*
+ * Analogue of Set for unsigned integer keys, based on van Emde Boas tree.
+ * It supports standard set operations in O(log(log(U))), where U is the universe size,
+ * using memory linear in number of keys:
+ * - insert
+ * - erase
+ * - find
+ * - lower_bound
+ * Constant of memory is large, as each node keeps hash table of clusters. Sparse keys take about
+ * 65-125 bytes per 32-bit key and 180-240 per 64-bit one, against 35-50 of Set, for 1e5-1e6 keys.
+ * Dense keys share 32-byte leaf bitmaps, so they take less than a byte each.
+ */
+template<class T>
+class IntegerSet {
+    static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value && !std::is_same<T, bool>::value,
+                  "IntegerSet: type must be unsigned integer");
+
+  public:
+    IntegerSet() = default;
+
+    IntegerSet(const IntegerSet& other) {
+        for (T val : other) {
+            insert(val);
+        }
+    }
+
+    // Assignment operator
+    IntegerSet& operator=(const IntegerSet& other) {
+        if (&other == this) {
+            return *this;
+        }
+        tree = Tree();
+        element_count = 0;
+        for (T val : other) {
+            insert(val);
+        }
+        return *this;
+    }
+
+    IntegerSet(const std::initializer_list<T>& elems) {
+        for (T val : elems) {
+            insert(val);
+        }
+    }
+
+    template<typename Iterator>
+    IntegerSet(const Iterator first, const Iterator last) {
+        for (Iterator it = first; it != last; ++it) {
+            insert(*it);
+        }
+    }
+
+    class iterator;
+
+    // If needed value exists, returns iterator on it, otherwise end().
+    iterator find(T val) const { return tree.contains(val) ? iterator(this, val) : end(); }
+
+    // Returns iterator on the lowest key >= val.
+    iterator lower_bound(T val) const {
+        uint64_t ans = 0;
+        return tree.lower_bound(val, ans) ? iterator(this, static_cast<T>(ans)) : end();
+    }
+
+    iterator begin() const { return tree.empty() ? end() : iterator(this, static_cast<T>(tree.min())); }
+
+    iterator end() const { return iterator(this); }
+
+    // Inserts element in tree. If such exists, does nothing.
+    void insert(T val) {
+        if (tree.insert(val)) {
+            ++element_count;
+        }
+    }
+
+    // Erases element from tree. If such doesn't exist, does nothing.
+    void erase(T val) {
+        if (tree.erase(val)) {
+            --element_count;
+        }
+    }
+
+    size_t size() const { return element_count; }
+
+    bool empty() const { return element_count == 0; }
+
+    /*
+     * Bidirectional iterator, holding the key itself
+     * Doesn't support random access
+     * Prefix/postfix increment/decrement works in O(log(log(U)))
+     * */
+    class iterator {
+      public:
+        iterator() = default;
+
+        bool operator==(const iterator& it) const {
+            return it.set == set && it.at_end == at_end && (at_end || it.value == value);
+        }
+
+        bool operator!=(const iterator& it) const { return !(*this == it); }
+
+        T operator*() const { return value; }
+
+        const T* operator->() const { return &value; }
+
+        iterator& operator++() {
+            uint64_t next = 0;
+            if (value == std::numeric_limits<T>::max() || !set->tree.lower_bound(uint64_t(value) + 1, next)) {
+                at_end = true;
+            } else {
+                value = static_cast<T>(next);
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        iterator& operator--() {
+            if (at_end) {
+                value = static_cast<T>(set->tree.max());
+                at_end = false;
+            } else {
+                uint64_t before = 0;
+                if (value == 0 || !set->tree.prev(uint64_t(value) - 1, before)) {
+                    // Like Set iterator, decrement of begin() leaves the set and can't be used further.
+                    *this = iterator();
+                    return *this;
+                }
+                value = static_cast<T>(before);
+            }
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+
+      private:
+        explicit iterator(const IntegerSet* set_) : set(set_) {}
+
+        iterator(const IntegerSet* set_, T value_) : set(set_), value(value_), at_end(false) {}
+
+        const IntegerSet* set = nullptr;
+        T value = 0;
+        bool at_end = true;
+
+        friend class IntegerSet;
+    };
+
+  private:
+    using Tree = VebNode<sizeof(T) * 8>;
+
+    Tree tree;
+    size_t element_count = 0;
+};
+
+/*
+ * Whether OrderedSet of T is IntegerSet. Off by default, as IntegerSet trades memory for speed of lookups
+ * on sparse keys, see above. Key type opts in by specialization, which must be unsigned integer:
+ * template<> struct UseIntegerSet<uint32_t> : std::true_type {};
+ */
+template<class T>
+struct UseIntegerSet : std::false_type {};
+
+// Picks IntegerSet for key types, which opted in by UseIntegerSet, and Set for everything else.
+template<class T, bool = UseIntegerSet<T>::value>
+struct SetSelector {
+    using type = Set<T>;
+};
+
+template<class T>
+struct SetSelector<T, true> {
+    using type = IntegerSet<T>;
+};
+
+template<class T>
+using OrderedSet = typename SetSelector<T>::type;
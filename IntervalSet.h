@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+
+#include "Set.h"
+
+/*
+ * Set of integer points, stored as maximal disjoint runs [lo, hi) in AVL tree.
+ * Neighbouring and overlapping runs are merged on insertion and split on erasure,
+ * so memory depends on number of runs, not points.
+ * Maximal value of type has no exclusive upper bound, so it can't be stored: insert and erase of it
+ * do nothing, and runs of insert_range end below it.
+ * It supports following operations in O(log(runs)), plus O(log(runs)) per each merged or removed run:
+ * - insert, insert_range
+ * - erase, erase_range
+ * - contains
+ * - lower_bound
+ */
+template<class T>
+class IntervalSet {
+    static_assert(std::is_integral<T>::value, "IntervalSet: type must be integer");
+
+  public:
+    // Run of consecutive points [lo, hi). Runs are ordered by lower bound.
+    struct Run {
+        T lo;
+        T hi;
+
+        bool operator<(const Run& other) const { return lo < other.lo; }
+    };
+
+    using run_iterator = typename Set<Run>::iterator;
+
+    IntervalSet() = default;
+
+    IntervalSet(const std::initializer_list<T>& elems) {
+        for (T val : elems) {
+            insert(val);
+        }
+    }
+
+    class iterator;
+
+    bool contains(T val) const {
+        run_iterator it = run_containing(val);
+        return it != run_set.end();
+    }
+
+    // If needed value exists, returns iterator on it, otherwise end().
+    iterator find(T val) const {
+        run_iterator it = run_containing(val);
+        return it == run_set.end() ? end() : iterator(&run_set, it, val);
+    }
+
+    // Returns iterator on the lowest point >= val.
+    iterator lower_bound(T val) const {
+        run_iterator it = run_containing(val);
+        if (it != run_set.end()) {
+            return iterator(&run_set, it, val);
+        }
+        it = run_set.lower_bound(Run{val, val});
+        return it == run_set.end() ? end() : iterator(&run_set, it, it->lo);
+    }
+
+    iterator begin() const {
+        run_iterator it = run_set.begin();
+        return it == run_set.end() ? end() : iterator(&run_set, it, it->lo);
+    }
+
+    iterator end() const { return iterator(&run_set, run_set.end(), T()); }
+
+    // Runs in ascending order.
+    const Set<Run>& runs() const { return run_set; }
+
+    void insert(T val) {
+        if (val != std::numeric_limits<T>::max()) {
+            insert_range(val, val + 1);
+        }
+    }
+
+    // Adds all points of [lo, hi), merging it with overlapping and adjacent runs.
+    void insert_range(T lo, T hi) {
+        if (!(lo < hi)) {
+            return;
+        }
+        run_iterator it = run_set.lower_bound(Run{lo, lo});
+        if (it != run_set.begin()) {
+            --it;
+            if (it->hi < lo) {
+                ++it;
+            }
+        }
+        // Absorb every run, starting not later than hi.
+        while (it != run_set.end() && !(hi < it->lo)) {
+            Run run = *it;
+            lo = run.lo < lo ? run.lo : lo;
+            hi = hi < run.hi ? run.hi : hi;
+            point_count -= length(run.lo, run.hi);
+            run_set.erase(run);
+            it = run_set.lower_bound(run);
+        }
+        run_set.insert(Run{lo, hi});
+        point_count += length(lo, hi);
+    }
+
+    void erase(T val) {
+        if (val != std::numeric_limits<T>::max()) {
+            erase_range(val, val + 1);
+        }
+    }
+
+    // Removes all points of [lo, hi), trimming or splitting runs on its borders.
+    void erase_range(T lo, T hi) {
+        if (!(lo < hi)) {
+            return;
+        }
+        run_iterator it = run_set.lower_bound(Run{lo, lo});
+        if (it != run_set.begin()) {
+            --it;
+            if (!(lo < it->hi)) {
+                ++it;
+            }
+        }
+        while (it != run_set.end() && it->lo < hi) {
+            Run run = *it;
+            run_set.erase(run);
+            point_count -= length(run.lo, run.hi);
+            if (run.lo < lo) {
+                run_set.insert(Run{run.lo, lo});
+                point_count += length(run.lo, lo);
+            }
+            if (hi < run.hi) {
+                run_set.insert(Run{hi, run.hi});
+                point_count += length(hi, run.hi);
+            }
+            it = run_set.lower_bound(Run{run.hi, run.hi});
+        }
+    }
+
+    // Number of points.
+    size_t size() const { return point_count; }
+
+    size_t run_count() const { return run_set.size(); }
+
+    bool empty() const { return run_set.empty(); }
+
+    /*
+     * Bidirectional iterator over points of runs
+     * Doesn't support random access
+     * Prefix/postfix increment/decrement works in amortized O(1)
+     * */
+    class iterator {
+      public:
+        iterator() = default;
+
+        bool operator==(const iterator& it) const { return it.run == run && it.value == value; }
+
+        bool operator!=(const iterator& it) const { return !(*this == it); }
+
+        T operator*() const { return value; }
+
+        iterator& operator++() {
+            if (++value == run->hi) {
+                ++run;
+                value = run == runs->end() ? T() : run->lo;
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        iterator& operator--() {
+            if (run == runs->end() || value == run->lo) {
+                --run;
+                value = run->hi;
+            }
+            --value;
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+
+      private:
+        iterator(const Set<Run>* runs_, run_iterator run_, T value_) : runs(runs_), run(run_), value(value_) {}
+
+        const Set<Run>* runs = nullptr;
+        run_iterator run;
+        T value = T();
+
+        friend class IntervalSet;
+    };
+
+  private:
+    // Number of points in [lo, hi). It is computed in unsigned type, as it may not fit in signed one.
+    static size_t length(T lo, T hi) {
+        using Unsigned = std::make_unsigned_t<T>;
+        return static_cast<Unsigned>(static_cast<Unsigned>(hi) - static_cast<Unsigned>(lo));
+    }
+
+    // Returns run, containing val, or end().
+    run_iterator run_containing(T val) const {
+        run_iterator it = run_set.lower_bound(Run{val, val});
+        if (it != run_set.end() && !(val < it->lo)) {
+            return it;
+        }
+        if (it == run_set.begin()) {
+            return run_set.end();
+        }
+        --it;
+        return val < it->hi ? it : run_set.end();
+    }
+
+    Set<Run> run_set;
+    size_t point_count = 0;
+};
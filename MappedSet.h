@@ -0,0 +1,481 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/*
+ * Persistent analogue of Set, whose nodes live in file-backed memory mapping.
+ * Nodes refer to each other by offsets from the beginning of the file instead of raw pointers,
+ * so existing set is opened in O(1) and can be queried immediately: OS pages nodes in on demand.
+ * Template type must be trivially copyable and have operator <.
+ * Mutations are done in place and are flushed to the file by sync().
+ * Set may be opened read-only by several processes at once, they share physical pages.
+ */
+template<class T>
+class MappedSet {
+    static_assert(std::is_trivially_copyable<T>::value, "MappedSet: type must be trivially copyable");
+
+  public:
+    /*
+     * Opens set, stored in file, or creates empty one, if file doesn't exist.
+     * Header is checked against file size, but offsets inside nodes are trusted, as checking them
+     * would take O(size) on open. So file must be written only by MappedSet.
+     */
+    explicit MappedSet(const std::string& path, bool read_only_ = false) : read_only(read_only_) {
+        fd = ::open(path.c_str(), read_only_ ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("MappedSet: can't open " + path);
+        }
+        try {
+            open_mapping(path);
+        } catch (...) {
+            unmap();
+            ::close(fd);
+            throw;
+        }
+    }
+
+    MappedSet(const MappedSet&) = delete;
+
+    MappedSet& operator=(const MappedSet&) = delete;
+
+    class iterator;
+
+    // If needed value exists, returns iterator on corresponding node, otherwise end().
+    iterator find(const T& val) const {
+        Offset cur = at(ROOT).left;
+        while (cur != NIL) {
+            if (val < at(cur).value) {
+                cur = at(cur).left;
+            } else if (at(cur).value < val) {
+                cur = at(cur).right;
+            } else {
+                return iterator(this, cur);
+            }
+        }
+        return end();
+    }
+
+    // Returns iterator on node with the lowest key >= val.
+    iterator lower_bound(const T& val) const {
+        Offset cur = at(ROOT).left;
+        Offset ans = ROOT;
+        while (cur != NIL) {
+            if (at(cur).value < val) {
+                cur = at(cur).right;
+            } else {
+                ans = cur;
+                cur = at(cur).left;
+            }
+        }
+        return iterator(this, ans);
+    }
+
+    iterator begin() const {
+        Offset ans = ROOT;
+        while (at(ans).left != NIL) {
+            ans = at(ans).left;
+        }
+        return iterator(this, ans);
+    }
+
+    iterator end() const { return iterator(this, ROOT); }
+
+    // Inserts element in tree. If such exists, does nothing.
+    void insert(const T& val) {
+        check_writable();
+        Offset top = recursive_insert(at(ROOT).left, val);
+        at(ROOT).left = top;
+        at(top).parent = ROOT;
+    }
+
+    // Erases element from tree. If such doesn't exist, does nothing.
+    void erase(const T& val) {
+        check_writable();
+        Offset top = recursive_erase(at(ROOT).left, val);
+        at(ROOT).left = top;
+        if (top != NIL) {
+            at(top).parent = ROOT;
+        }
+    }
+
+    size_t size() const { return header().count; }
+
+    bool empty() const { return header().count == 0; }
+
+    // Flushes all modifications to the file.
+    void sync() {
+        if (!read_only && ::msync(base, mapped_size, MS_SYNC) != 0) {
+            throw std::runtime_error("MappedSet: sync failed");
+        }
+    }
+
+    ~MappedSet() {
+        unmap();
+        ::close(fd);
+    }
+
+  private:
+    using Offset = uint64_t;
+
+    // Header, stored at the beginning of the file.
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key_size;
+        uint64_t count;
+        Offset free_list;
+        Offset next;  // First never used slot.
+    };
+
+    // Auxiliary class for storing node's information. Released nodes are linked into free list by parent.
+    struct Node {
+        static constexpr int32_t UNDEFINED = -1;
+        static constexpr int32_t LEFT = 0;
+        static constexpr int32_t RIGHT = -1;
+        Offset parent;
+        Offset left;
+        Offset right;
+        int32_t height;
+        T value;
+    };
+
+  public:
+    /*
+     * Bidirectional iterator for AVL tree nodes
+     * Doesn't support random access
+     * Iterators are invalidated by any insertion, as it may remap the file
+     * */
+    class iterator {
+      public:
+        iterator() = default;
+
+        iterator(const MappedSet* set_, Offset node_) : set(set_), node(node_) {}
+
+        bool operator==(const iterator& it) const { return it.node == node; }
+
+        bool operator!=(const iterator& it) const { return it.node != node; }
+
+        T operator*() const { return set->at(node).value; }
+
+        const T* operator->() const { return &set->at(node).value; }
+
+        iterator& operator++() {
+            node = set->get_next_vertex(node);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        iterator& operator--() {
+            node = set->get_prev_vertex(node);
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+
+      private:
+        const MappedSet* set = nullptr;
+        Offset node = NIL;
+    };
+
+  private:
+    Header& header() const { return *reinterpret_cast<Header*>(base); }
+
+    Node& at(Offset off) const { return *reinterpret_cast<Node*>(base + off); }
+
+    // Maps existing file, or initializes empty set in the new one.
+    void open_mapping(const std::string& path) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            throw std::runtime_error("MappedSet: can't stat " + path);
+        }
+        mapped_size = static_cast<size_t>(st.st_size);
+        if (mapped_size == 0 && !read_only) {
+            mapped_size = FIRST + INITIAL_NODES * sizeof(Node);
+            if (::ftruncate(fd, static_cast<off_t>(mapped_size)) != 0) {
+                throw std::runtime_error("MappedSet: can't resize " + path);
+            }
+            base = map(mapped_size);
+            // Fresh file is zero-filled, so only non-zero fields are set.
+            header() = Header{MAGIC, VERSION, sizeof(T), 0, NIL, FIRST + sizeof(Node)};
+            at(ROOT).height = Node::UNDEFINED;
+            return;
+        }
+        if (mapped_size < FIRST + sizeof(Node)) {
+            throw std::runtime_error("MappedSet: unsupported format of " + path);
+        }
+        base = map(mapped_size);
+        if (header().magic != MAGIC || header().version != VERSION || header().key_size != sizeof(T)) {
+            throw std::runtime_error("MappedSet: unsupported format of " + path);
+        }
+        // Slots [FIRST + sizeof(Node), next) must lie in the file and hold every live node.
+        const Header& h = header();
+        Offset first_node = FIRST + sizeof(Node);
+        if (h.next < first_node || h.next > mapped_size || (h.next - FIRST) % sizeof(Node) != 0 ||
+            h.count > (h.next - first_node) / sizeof(Node) || (h.free_list != NIL && !is_slot(h.free_list)) ||
+            (at(ROOT).left != NIL && !is_slot(at(ROOT).left)) || (h.count == 0) != (at(ROOT).left == NIL)) {
+            throw std::runtime_error("MappedSet: corrupted header of " + path);
+        }
+    }
+
+    // Whether offset points to node slot, which was ever used.
+    bool is_slot(Offset off) const {
+        return off >= FIRST + sizeof(Node) && off < header().next && (off - FIRST) % sizeof(Node) == 0;
+    }
+
+    char* map(size_t size) const {
+        void* addr = ::mmap(nullptr, size, read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("MappedSet: mmap failed");
+        }
+        return static_cast<char*>(addr);
+    }
+
+    void unmap() {
+        if (base != nullptr) {
+            ::munmap(base, mapped_size);
+            base = nullptr;
+        }
+    }
+
+    void check_writable() const {
+        if (read_only) {
+            throw std::runtime_error("MappedSet: set is opened read-only");
+        }
+    }
+
+    // Doubles the file. Offsets stay valid, but all references to nodes must be taken anew.
+    // Old mapping is released only after the new one is made, so on failure the set stays as it was.
+    void grow() {
+        size_t new_size = mapped_size * TWO;
+        if (::ftruncate(fd, static_cast<off_t>(new_size)) != 0) {
+            throw std::runtime_error("MappedSet: can't grow file");
+        }
+        char* new_base = map(new_size);
+        ::munmap(base, mapped_size);
+        base = new_base;
+        mapped_size = new_size;
+    }
+
+    Offset create_node(const T& val) {
+        Offset node = header().free_list;
+        if (node != NIL) {
+            header().free_list = at(node).parent;
+        } else {
+            if (header().next + sizeof(Node) > mapped_size) {
+                grow();
+            }
+            node = header().next;
+            header().next += sizeof(Node);
+        }
+        at(node) = Node{NIL, NIL, NIL, 0, val};
+        ++header().count;
+        return node;
+    }
+
+    void release_node(Offset node) {
+        at(node).parent = header().free_list;
+        header().free_list = node;
+        --header().count;
+    }
+
+    int get_parent_direction(Offset child) const {
+        return at(at(child).parent).left == child ? Node::LEFT : Node::RIGHT;
+    }
+
+    Offset get_leftest_node(Offset node) const {
+        while (at(node).left != NIL) {
+            node = at(node).left;
+        }
+        return node;
+    }
+
+    Offset get_rightest_node(Offset node) const {
+        while (at(node).right != NIL) {
+            node = at(node).right;
+        }
+        return node;
+    }
+
+    // Auxiliary method for finding next node in tree.
+    Offset get_next_vertex(Offset node) const {
+        if (at(node).right != NIL) {
+            return get_leftest_node(at(node).right);
+        }
+        while (at(node).parent != NIL) {
+            int32_t dir = get_parent_direction(node);
+            node = at(node).parent;
+            if (dir == Node::LEFT) {
+                return node;
+            }
+        }
+        return NIL;
+    }
+
+    // Auxiliary method for finding previous node in tree.
+    Offset get_prev_vertex(Offset node) const {
+        if (at(node).left != NIL) {
+            return get_rightest_node(at(node).left);
+        }
+        while (at(node).parent != NIL) {
+            int32_t dir = get_parent_direction(node);
+            node = at(node).parent;
+            if (dir == Node::RIGHT) {
+                return node;
+            }
+        }
+        return NIL;
+    }
+
+    int32_t get_height(Offset node) const { return node == NIL ? Node::UNDEFINED : at(node).height; }
+
+    int32_t height_difference(Offset node) const {
+        return node != NIL ? get_height(at(node).left) - get_height(at(node).right) : 0;
+    }
+
+    void update_height(Offset node) {
+        at(node).height = 1 + std::max(get_height(at(node).left), get_height(at(node).right));
+    }
+
+    Offset left_rotate(Offset node) {
+        Offset temp = at(node).right;
+        at(node).right = at(temp).left;
+        if (at(temp).left != NIL) {
+            at(at(temp).left).parent = node;
+        }
+        at(temp).left = node;
+        at(temp).parent = at(node).parent;
+        at(node).parent = temp;
+        update_height(node);
+        update_height(temp);
+        return temp;
+    }
+
+    Offset right_rotate(Offset node) {
+        Offset temp = at(node).left;
+        at(node).left = at(temp).right;
+        if (at(temp).right != NIL) {
+            at(at(temp).right).parent = node;
+        }
+        at(temp).right = node;
+        at(temp).parent = at(node).parent;
+        at(node).parent = temp;
+        update_height(node);
+        update_height(temp);
+        return temp;
+    }
+
+    // Standard AVL's rotate implementation.
+    Offset rotate(Offset node) {
+        int32_t n_diff = height_difference(node);
+        if (n_diff == -TWO) {
+            if (height_difference(at(node).right) == ONE) {
+                Offset right = right_rotate(at(node).right);
+                at(node).right = right;
+            }
+            node = left_rotate(node);
+        } else if (n_diff == TWO) {
+            if (height_difference(at(node).left) == -ONE) {
+                Offset left = left_rotate(at(node).left);
+                at(node).left = left;
+            }
+            node = right_rotate(node);
+        }
+        return node;
+    }
+
+    // Auxiliary function for erasing element from tree.
+    Offset recursive_erase(Offset node, const T& val) {
+        if (node == NIL) {
+            return node;
+        }
+        if (val < at(node).value) {
+            Offset left = recursive_erase(at(node).left, val);
+            at(node).left = left;
+            if (left != NIL) {
+                at(left).parent = node;
+            }
+        } else if (at(node).value < val) {
+            Offset right = recursive_erase(at(node).right, val);
+            at(node).right = right;
+            if (right != NIL) {
+                at(right).parent = node;
+            }
+        } else {
+            if (at(node).left != NIL && at(node).right != NIL) {
+                T next_value = at(get_leftest_node(at(node).right)).value;
+                at(node).value = next_value;
+                Offset right = recursive_erase(at(node).right, next_value);
+                at(node).right = right;
+                if (right != NIL) {
+                    at(right).parent = node;
+                }
+            } else {
+                Offset temp = at(node).left != NIL ? at(node).left : at(node).right;
+                release_node(node);
+                node = temp;
+                if (node != NIL) {
+                    at(node).parent = NIL;
+                }
+            }
+        }
+        if (node == NIL) {
+            return node;
+        }
+        node = rotate(node);
+        update_height(node);
+        return node;
+    }
+
+    // Auxiliary function for inserting element into tree. Allocation may remap the file,
+    // so references to nodes are never held across the recursive call.
+    Offset recursive_insert(Offset node, const T& val) {
+        if (node == NIL) {
+            node = create_node(val);
+        } else if (val < at(node).value) {
+            Offset left = recursive_insert(at(node).left, val);
+            at(node).left = left;
+            at(left).parent = node;
+        } else if (at(node).value < val) {
+            Offset right = recursive_insert(at(node).right, val);
+            at(node).right = right;
+            at(right).parent = node;
+        }
+        node = rotate(node);
+        update_height(node);
+        return node;
+    }
+
+    static constexpr Offset NIL = 0;
+    // Sentinel node, representing end() iterator, goes right after the header.
+    static constexpr Offset FIRST = (sizeof(Header) + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+    static constexpr Offset ROOT = FIRST;
+    static constexpr size_t INITIAL_NODES = 1024;
+    static constexpr int32_t ONE = 1;
+    static constexpr int32_t TWO = 2;
+    static constexpr uint32_t MAGIC = 0x4d4c5641;  // "AVLM"
+    static constexpr uint32_t VERSION = 1;
+
+    bool read_only;
+    int fd = -1;
+    char* base = nullptr;
+    size_t mapped_size = 0;
+};
@@ -0,0 +1,485 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+/*
+ * Persistent analogue of Set: AVL tree, whose versions share all untouched subtrees.
+ * Copy of the set is O(1) snapshot, which stays readable and unchanged, while the original
+ * keeps being modified. Update copies only nodes, shared with other versions, on the path from root,
+ * and modifies in place the ones, owned by this version alone, so set without snapshots copies nothing.
+ * Nodes are reference counted and freed with the last version, holding them.
+ * Nodes have no parent links, which can't be shared, so iterator keeps path from root.
+ * Template type must have operator <.
+ * It supports standard set operations in guaranteed O(log(tree_size)):
+ * - insert
+ * - erase
+ * - find
+ * - lower_bound
+ * Versions may be read, copied and destroyed from different threads, but each one must be modified
+ * by one thread at a time.
+ */
+template<class T>
+class PersistentSet {
+  public:
+    PersistentSet() = default;
+
+    PersistentSet(const PersistentSet& other) : root(retain(other.root)), element_count(other.element_count) {}
+
+    PersistentSet(PersistentSet&& other) noexcept : root(other.root), element_count(other.element_count) {
+        other.root = nullptr;
+        other.element_count = 0;
+    }
+
+    PersistentSet& operator=(const PersistentSet& other) {
+        Node* old = root;
+        root = retain(other.root);
+        element_count = other.element_count;
+        release(old);
+        return *this;
+    }
+
+    PersistentSet& operator=(PersistentSet&& other) noexcept {
+        std::swap(root, other.root);
+        std::swap(element_count, other.element_count);
+        return *this;
+    }
+
+    PersistentSet(const std::initializer_list<T>& elems) {
+        for (const T& val : elems) {
+            insert(val);
+        }
+    }
+
+    template<typename Iterator>
+    PersistentSet(const Iterator first, const Iterator last) {
+        for (Iterator it = first; it != last; ++it) {
+            insert(*it);
+        }
+    }
+
+    class iterator;
+
+    // Point-in-time view of the set in O(1). Same as copying.
+    PersistentSet snapshot() const { return *this; }
+
+    // If needed value exists, returns iterator on it, otherwise end().
+    iterator find(const T& val) const {
+        iterator it = lower_bound(val);
+        return it == end() || val < *it ? end() : it;
+    }
+
+    bool contains(const T& val) const {
+        const Node* cur = root;
+        while (cur) {
+            if (val < cur->value) {
+                cur = cur->left;
+            } else if (cur->value < val) {
+                cur = cur->right;
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns iterator on the lowest key >= val.
+    iterator lower_bound(const T& val) const {
+        iterator it(root);
+        size_t depth = 0;
+        for (const Node* cur = root; cur != nullptr; ) {
+            it.path.push_back(cur);
+            if (cur->value < val) {
+                cur = cur->right;
+            } else {
+                depth = it.path.size();
+                cur = cur->left;
+            }
+        }
+        // Answer is the deepest node on the path, where search went left.
+        it.path.resize(depth);
+        return it;
+    }
+
+    iterator begin() const {
+        iterator it(root);
+        it.push_leftmost(root);
+        return it;
+    }
+
+    iterator end() const { return iterator(root); }
+
+    // Inserts element in tree. If such exists, does nothing. Other versions are not affected.
+    void insert(const T& val) {
+        if (contains(val)) {
+            return;
+        }
+        root = insert(root, val);
+        ++element_count;
+    }
+
+    // Erases element from tree. If such doesn't exist, does nothing. Other versions are not affected.
+    void erase(const T& val) {
+        if (!contains(val)) {
+            return;
+        }
+        root = erase(root, val);
+        --element_count;
+    }
+
+    size_t size() const { return element_count; }
+
+    bool empty() const { return element_count == 0; }
+
+    /*
+     * Reports difference between versions in ascending order of keys: on_added(key) for keys of b,
+     * missing in a, and on_removed(key) for keys of a, missing in b. Subtrees, shared by both versions,
+     * are skipped by pointer, so versions of one set are compared in O(changes * log(tree_size)).
+     * Unrelated sets are merged in O(size(a) + size(b)).
+     */
+    template<typename OnAdded, typename OnRemoved>
+    friend void diff(const PersistentSet& a, const PersistentSet& b, OnAdded on_added, OnRemoved on_removed) {
+        DiffCursor old_keys(a.root);
+        DiffCursor new_keys(b.root);
+        while (!old_keys.empty() && !new_keys.empty()) {
+            const Node* x = old_keys.top();
+            const Node* y = new_keys.top();
+            if (old_keys.whole() && new_keys.whole() && x == y) {
+                old_keys.pop();
+                new_keys.pop();
+            } else if (old_keys.whole() && new_keys.whole() && x->height == y->height) {
+                // Of different subtrees of equal height, the one with lower root key isn't in the other version:
+                // there it would have to follow the other subtree, which holds the next keys. With equal root keys,
+                // neither of them is shared.
+                if (x->value < y->value) {
+                    old_keys.expand();
+                } else if (y->value < x->value) {
+                    new_keys.expand();
+                } else {
+                    old_keys.expand();
+                    new_keys.expand();
+                }
+            } else if (old_keys.whole() || new_keys.whole()) {
+                // Shared subtree has the same height in both versions, so the higher side is expanded first.
+                int32_t old_height = old_keys.whole() ? x->height : Node::UNDEFINED;
+                int32_t new_height = new_keys.whole() ? y->height : Node::UNDEFINED;
+                if (old_height > new_height) {
+                    old_keys.expand();
+                } else {
+                    new_keys.expand();
+                }
+            } else if (x->value < y->value) {
+                on_removed(x->value);
+                old_keys.pop();
+            } else if (y->value < x->value) {
+                on_added(y->value);
+                new_keys.pop();
+            } else {
+                old_keys.pop();
+                new_keys.pop();
+            }
+        }
+        old_keys.drain(on_removed);
+        new_keys.drain(on_added);
+    }
+
+    ~PersistentSet() { release(root); }
+
+  private:
+    // Auxiliary class for storing node's information.
+    struct Node {
+        static constexpr int32_t UNDEFINED = -1;
+        Node* left = nullptr;
+        Node* right = nullptr;
+        int32_t height = 0;
+        // Number of parents and versions, holding the node.
+        std::atomic<uint32_t> refs{1};
+        T value;
+
+        explicit Node(const T& val) : value(val) {}
+
+        // Copy, which holds the same children.
+        explicit Node(const Node* other) : left(retain(other->left)), right(retain(other->right)),
+                                           height(other->height), value(other->value) {}
+    };
+
+  public:
+    /*
+     * Bidirectional iterator, keeping path from root to its node
+     * Doesn't support random access
+     * Prefix/postfix increment/decrement works in amortized O(1)
+     * Stays valid while any version, holding its node, exists.
+     * */
+    class iterator {
+      public:
+        iterator() = default;
+
+        bool operator==(const iterator& it) const { return node() == it.node(); }
+
+        bool operator!=(const iterator& it) const { return !(*this == it); }
+
+        T operator*() const { return node()->value; }
+
+        const T* operator->() const { return &node()->value; }
+
+        iterator& operator++() {
+            const Node* cur = node();
+            if (cur->right != nullptr) {
+                push_leftmost(cur->right);
+                return *this;
+            }
+            // Climb while coming from the right child.
+            path.pop_back();
+            while (!path.empty() && path.back()->right == cur) {
+                cur = path.back();
+                path.pop_back();
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        iterator& operator--() {
+            if (path.empty()) {
+                push_rightmost(tree);
+                return *this;
+            }
+            const Node* cur = node();
+            if (cur->left != nullptr) {
+                push_rightmost(cur->left);
+                return *this;
+            }
+            // Climb while coming from the left child.
+            path.pop_back();
+            while (!path.empty() && path.back()->left == cur) {
+                cur = path.back();
+                path.pop_back();
+            }
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+
+      private:
+        explicit iterator(const Node* tree_) : tree(tree_) {}
+
+        // Current node, or null for end().
+        const Node* node() const { return path.empty() ? nullptr : path.back(); }
+
+        void push_leftmost(const Node* cur) {
+            for (; cur != nullptr; cur = cur->left) {
+                path.push_back(cur);
+            }
+        }
+
+        void push_rightmost(const Node* cur) {
+            for (; cur != nullptr; cur = cur->right) {
+                path.push_back(cur);
+            }
+        }
+
+        // Root of the version, which iterator came from, for stepping back from end().
+        const Node* tree = nullptr;
+        std::vector<const Node*> path;
+
+        friend class PersistentSet;
+    };
+
+  private:
+    // Rest of in-order sequence of version: stack of subtrees, which are not expanded yet,
+    // and single nodes, whose left subtrees are already passed.
+    class DiffCursor {
+      public:
+        explicit DiffCursor(const Node* root) { push_subtree(root); }
+
+        bool empty() const { return stack.empty(); }
+
+        const Node* top() const { return stack.back().node; }
+
+        // Whether top stands for its whole subtree.
+        bool whole() const { return stack.back().whole; }
+
+        void pop() { stack.pop_back(); }
+
+        // Replaces subtree on top by its left subtree, its root and its right subtree.
+        void expand() {
+            const Node* node = top();
+            pop();
+            push_subtree(node->right);
+            stack.push_back(Entry{node, false});
+            push_subtree(node->left);
+        }
+
+        // Passes all remaining keys to callback.
+        template<typename Callback>
+        void drain(Callback& callback) {
+            while (!empty()) {
+                if (whole()) {
+                    expand();
+                } else {
+                    callback(top()->value);
+                    pop();
+                }
+            }
+        }
+
+      private:
+        struct Entry {
+            const Node* node;
+            bool whole;
+        };
+
+        void push_subtree(const Node* node) {
+            if (node != nullptr) {
+                stack.push_back(Entry{node, true});
+            }
+        }
+
+        std::vector<Entry> stack;
+    };
+
+    static Node* retain(Node* node) {
+        if (node != nullptr) {
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        return node;
+    }
+
+    // Drops one reference to node. Last one frees it and releases its children.
+    static void release(Node* node) {
+        while (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release(node->left);
+            Node* right = node->right;
+            delete node;
+            node = right;
+        }
+    }
+
+    /*
+     * Takes over caller's reference to node and returns node, which may be modified: node itself,
+     * if no one else holds it, otherwise its copy.
+     */
+    static Node* own(Node* node) {
+        if (node->refs.load(std::memory_order_acquire) == 1) {
+            return node;
+        }
+        Node* copy = new Node(node);
+        release(node);
+        return copy;
+    }
+
+    static int32_t get_height(const Node* node) { return node == nullptr ? Node::UNDEFINED : node->height; }
+
+    static int32_t height_difference(const Node* node) { return get_height(node->left) - get_height(node->right); }
+
+    static void update_height(Node* node) {
+        node->height = 1 + std::max(get_height(node->left), get_height(node->right));
+    }
+
+    // Rotations take over reference to owned node and return owned new top.
+    static Node* left_rotate(Node* node) {
+        Node* temp = own(node->right);
+        node->right = temp->left;
+        temp->left = node;
+        update_height(node);
+        update_height(temp);
+        return temp;
+    }
+
+    static Node* right_rotate(Node* node) {
+        Node* temp = own(node->left);
+        node->left = temp->right;
+        temp->right = node;
+        update_height(node);
+        update_height(temp);
+        return temp;
+    }
+
+    // Standard AVL's rotate implementation for owned node.
+    static Node* rotate(Node* node) {
+        update_height(node);
+        int32_t n_diff = height_difference(node);
+        if (n_diff == -TWO) {
+            if (height_difference(node->right) == ONE) {
+                node->right = right_rotate(own(node->right));
+            }
+            node = left_rotate(node);
+        } else if (n_diff == TWO) {
+            if (height_difference(node->left) == -ONE) {
+                node->left = left_rotate(own(node->left));
+            }
+            node = right_rotate(node);
+        }
+        return node;
+    }
+
+    // Recursive functions take over reference to node and return reference to new subtree.
+    static Node* insert(Node* node, const T& val) {
+        if (node == nullptr) {
+            return new Node(val);
+        }
+        node = own(node);
+        if (val < node->value) {
+            node->left = insert(node->left, val);
+        } else {
+            node->right = insert(node->right, val);
+        }
+        return rotate(node);
+    }
+
+    // Val must be present in subtree.
+    static Node* erase(Node* node, const T& val) {
+        bool found = !(val < node->value) && !(node->value < val);
+        if (found && (node->left == nullptr || node->right == nullptr)) {
+            Node* child = retain(node->left ? node->left : node->right);
+            release(node);
+            return child;
+        }
+        node = own(node);
+        if (found) {
+            // Node takes key of the next one, which is unlinked instead.
+            node->right = erase_min(node->right, node->value);
+        } else if (val < node->value) {
+            node->left = erase(node->left, val);
+        } else {
+            node->right = erase(node->right, val);
+        }
+        return rotate(node);
+    }
+
+    // Unlinks the minimum of nonempty subtree, passing its key to min.
+    static Node* erase_min(Node* node, T& min) {
+        if (node->left == nullptr) {
+            // Key of shared node is still needed by other versions.
+            if (node->refs.load(std::memory_order_acquire) == 1) {
+                min = std::move(node->value);
+            } else {
+                min = node->value;
+            }
+            Node* right = retain(node->right);
+            release(node);
+            return right;
+        }
+        node = own(node);
+        node->left = erase_min(node->left, min);
+        return rotate(node);
+    }
+
+    Node* root = nullptr;
+    size_t element_count = 0;
+    static constexpr int32_t ONE = 1;
+    static constexpr int32_t TWO = 2;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+
+#include "ConcurrentSet.h"
+#include "PersistentSet.h"
+
+/*
+ * Set for one writer and many readers, in the manner of read-copy-update.
+ * Readers see immutable published version of PersistentSet: they pin the epoch, load the pointer
+ * to version and read it without any locks or shared writes, so they don't slow down each other.
+ * Writer changes its own version by path copying and publishes it with one pointer exchange.
+ * Replaced version is retired through epochs and freed, when no reader can hold it, together
+ * with nodes, not shared with newer versions.
+ * Template type must have operator <.
+ * Readers may run in any number of threads. Updates must come from one thread at a time.
+ * It supports following operations in O(log(tree_size)):
+ * - insert, erase: they also allocate O(log(tree_size)) copied nodes
+ * - contains
+ * - lower_bound
+ * - iteration over consistent version, pinned by Reader
+ */
+template<class T>
+class RcuSet {
+    using Version = PersistentSet<T>;
+    using Epochs = SetEpochs<Version>;
+
+  public:
+    RcuSet() : published(new Version()) {}
+
+    RcuSet(const RcuSet&) = delete;
+
+    RcuSet& operator=(const RcuSet&) = delete;
+
+    RcuSet(const std::initializer_list<T>& elems) : RcuSet() {
+        update([&elems](Version& version) {
+            for (const T& val : elems) {
+                version.insert(val);
+            }
+        });
+    }
+
+    ~RcuSet() { delete published.load(); }
+
+    /*
+     * Pins the version, published at the moment of construction. It stays valid and unchanged,
+     * while the reader lives, so its iterators may be used for consistent ordered traversal.
+     * Writer doesn't wait for readers, but reader should be short-lived, as it keeps retired versions.
+     */
+    class Reader {
+      public:
+        explicit Reader(const RcuSet& set) : guard(set.epochs), version(set.published.load()) {}
+
+        Reader(const Reader&) = delete;
+
+        Reader& operator=(const Reader&) = delete;
+
+        const Version& operator*() const { return *version; }
+
+        const Version* operator->() const { return version; }
+
+      private:
+        typename Epochs::Guard guard;
+        const Version* version;
+    };
+
+    bool contains(const T& val) const {
+        Reader reader(*this);
+        return reader->contains(val);
+    }
+
+    // Finds the lowest key >= val and writes it to result. Returns false, if there is no such key.
+    bool lower_bound(const T& val, T& result) const {
+        Reader reader(*this);
+        typename Version::iterator it = reader->lower_bound(val);
+        if (it == reader->end()) {
+            return false;
+        }
+        result = *it;
+        return true;
+    }
+
+    // Inserts element and publishes new version. If such exists, does nothing.
+    void insert(const T& val) {
+        if (!writing.contains(val)) {
+            update([&val](Version& version) { version.insert(val); });
+        }
+    }
+
+    // Erases element and publishes new version. If such doesn't exist, does nothing.
+    void erase(const T& val) {
+        if (writing.contains(val)) {
+            update([&val](Version& version) { version.erase(val); });
+        }
+    }
+
+    // Applies modify(PersistentSet<T>&) to writer's version and publishes all its changes at once.
+    template<typename Modify>
+    void update(Modify modify) {
+        modify(writing);
+        typename Epochs::Guard guard(epochs);
+        guard.retire(published.exchange(new Version(writing)));
+    }
+
+    // Size of the latest published version.
+    size_t size() const {
+        Reader reader(*this);
+        return reader->size();
+    }
+
+    bool empty() const { return size() == 0; }
+
+  private:
+    // Version of the writer. Its nodes, shared with published versions, are copied before changes.
+    Version writing;
+    std::atomic<Version*> published;
+    mutable Epochs epochs;
+};
@@ -0,0 +1,643 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/*
+ * Analogue of Set for uint32_t keys, stored as compressed bitmap in the style of Roaring.
+ * Key space is split into chunks of 2^16 keys by the upper 16 bits. Each non-empty chunk keeps
+ * the lower 16 bits in the container, which suits its density best:
+ * - array: sorted array of up to 4096 keys
+ * - bitmap: 2^16 bits
+ * - run: sorted list of maximal ranges of consecutive keys, see run_optimize()
+ * It supports standard set operations in O(log(chunks) + container operation):
+ * - insert
+ * - erase
+ * - find
+ * - lower_bound
+ * and bulk union and intersection, working word by word on bitmaps.
+ */
+class RoaringSet {
+  public:
+    RoaringSet() = default;
+
+    RoaringSet(const std::initializer_list<uint32_t>& elems) {
+        for (uint32_t val : elems) {
+            insert(val);
+        }
+    }
+
+    template<typename Iterator>
+    RoaringSet(const Iterator first, const Iterator last) {
+        for (Iterator it = first; it != last; ++it) {
+            insert(*it);
+        }
+    }
+
+    class iterator;
+
+    // If needed value exists, returns iterator on it, otherwise end().
+    iterator find(uint32_t val) const {
+        size_t i = chunk_position(high(val));
+        if (i < chunks.size() && chunks[i].first == high(val) && chunks[i].second.contains(low(val))) {
+            return iterator(this, i, low(val));
+        }
+        return end();
+    }
+
+    // Returns iterator on the lowest key >= val.
+    iterator lower_bound(uint32_t val) const {
+        size_t i = chunk_position(high(val));
+        if (i < chunks.size() && chunks[i].first == high(val)) {
+            uint16_t ans;
+            if (chunks[i].second.lower_bound(low(val), ans)) {
+                return iterator(this, i, ans);
+            }
+            ++i;
+        }
+        return i < chunks.size() ? iterator(this, i, chunks[i].second.min()) : end();
+    }
+
+    iterator begin() const { return chunks.empty() ? end() : iterator(this, 0, chunks[0].second.min()); }
+
+    iterator end() const { return iterator(this, chunks.size(), 0); }
+
+    // Inserts element in set. If such exists, does nothing.
+    void insert(uint32_t val) {
+        size_t i = chunk_position(high(val));
+        if (i == chunks.size() || chunks[i].first != high(val)) {
+            chunks.insert(chunks.begin() + i, Chunk(high(val), Container()));
+        }
+        if (chunks[i].second.insert(low(val))) {
+            ++element_count;
+        }
+    }
+
+    // Erases element from set. If such doesn't exist, does nothing.
+    void erase(uint32_t val) {
+        size_t i = chunk_position(high(val));
+        if (i == chunks.size() || chunks[i].first != high(val) || !chunks[i].second.erase(low(val))) {
+            return;
+        }
+        --element_count;
+        if (chunks[i].second.cardinality == 0) {
+            chunks.erase(chunks.begin() + i);
+        }
+    }
+
+    size_t size() const { return element_count; }
+
+    bool empty() const { return element_count == 0; }
+
+    // Converts every container to the most compact of array, bitmap and run representations.
+    void run_optimize() {
+        for (Chunk& chunk : chunks) {
+            chunk.second.optimize();
+        }
+    }
+
+    // Adds all keys of other set.
+    RoaringSet& operator|=(const RoaringSet& other) {
+        std::vector<Chunk> result;
+        result.reserve(chunks.size() + other.chunks.size());
+        size_t i = 0;
+        size_t j = 0;
+        while (i < chunks.size() || j < other.chunks.size()) {
+            if (j == other.chunks.size() || (i < chunks.size() && chunks[i].first < other.chunks[j].first)) {
+                result.push_back(std::move(chunks[i++]));
+            } else if (i == chunks.size() || other.chunks[j].first < chunks[i].first) {
+                result.push_back(other.chunks[j++]);
+            } else {
+                result.emplace_back(chunks[i].first, Container::unite(chunks[i].second, other.chunks[j].second));
+                ++i;
+                ++j;
+            }
+        }
+        chunks = std::move(result);
+        recount();
+        return *this;
+    }
+
+    // Leaves only keys, which other set contains too.
+    RoaringSet& operator&=(const RoaringSet& other) {
+        std::vector<Chunk> result;
+        size_t j = 0;
+        for (Chunk& chunk : chunks) {
+            while (j < other.chunks.size() && other.chunks[j].first < chunk.first) {
+                ++j;
+            }
+            if (j == other.chunks.size()) {
+                break;
+            }
+            if (other.chunks[j].first == chunk.first) {
+                Container common = Container::intersect(chunk.second, other.chunks[j].second);
+                if (common.cardinality > 0) {
+                    result.emplace_back(chunk.first, std::move(common));
+                }
+            }
+        }
+        chunks = std::move(result);
+        recount();
+        return *this;
+    }
+
+    friend RoaringSet operator|(RoaringSet a, const RoaringSet& b) { return a |= b; }
+
+    friend RoaringSet operator&(RoaringSet a, const RoaringSet& b) { return a &= b; }
+
+  private:
+    // Lower 16 bits of keys of one chunk.
+    struct Container {
+        enum Type { ARRAY, BITMAP, RUN };
+
+        // Inclusive range of consecutive keys.
+        struct Run {
+            uint16_t first;
+            uint16_t last;
+        };
+
+        Type type = ARRAY;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bitmap;
+        std::vector<Run> runs;
+
+        bool contains(uint16_t x) const {
+            switch (type) {
+                case ARRAY:
+                    return std::binary_search(array.begin(), array.end(), x);
+                case BITMAP:
+                    return bitmap[x / WORD] >> (x % WORD) & 1;
+                default:
+                    auto it = run_after(x);
+                    return it != runs.begin() && std::prev(it)->last >= x;
+            }
+        }
+
+        bool insert(uint16_t x) {
+            switch (type) {
+                case ARRAY: {
+                    auto it = std::lower_bound(array.begin(), array.end(), x);
+                    if (it != array.end() && *it == x) {
+                        return false;
+                    }
+                    array.insert(it, x);
+                    if (++cardinality > ARRAY_MAX) {
+                        to_bitmap();
+                    }
+                    return true;
+                }
+                case BITMAP: {
+                    uint64_t bit = uint64_t(1) << (x % WORD);
+                    if (bitmap[x / WORD] & bit) {
+                        return false;
+                    }
+                    bitmap[x / WORD] |= bit;
+                    ++cardinality;
+                    return true;
+                }
+                default:
+                    return insert_into_runs(x);
+            }
+        }
+
+        bool erase(uint16_t x) {
+            switch (type) {
+                case ARRAY: {
+                    auto it = std::lower_bound(array.begin(), array.end(), x);
+                    if (it == array.end() || *it != x) {
+                        return false;
+                    }
+                    array.erase(it);
+                    --cardinality;
+                    return true;
+                }
+                case BITMAP: {
+                    uint64_t bit = uint64_t(1) << (x % WORD);
+                    if (!(bitmap[x / WORD] & bit)) {
+                        return false;
+                    }
+                    bitmap[x / WORD] &= ~bit;
+                    if (--cardinality <= ARRAY_MAX / 2) {
+                        to_array();
+                    }
+                    return true;
+                }
+                default:
+                    return erase_from_runs(x);
+            }
+        }
+
+        // Finds the lowest key >= x.
+        bool lower_bound(uint32_t x, uint16_t& ans) const {
+            if (x > UINT16_MAX) {
+                return false;
+            }
+            switch (type) {
+                case ARRAY: {
+                    auto it = std::lower_bound(array.begin(), array.end(), x);
+                    if (it == array.end()) {
+                        return false;
+                    }
+                    ans = *it;
+                    return true;
+                }
+                case BITMAP: {
+                    size_t i = x / WORD;
+                    uint64_t word = bitmap[i] & (~uint64_t(0) << (x % WORD));
+                    while (word == 0) {
+                        if (++i == BITMAP_WORDS) {
+                            return false;
+                        }
+                        word = bitmap[i];
+                    }
+                    ans = static_cast<uint16_t>(i * WORD + __builtin_ctzll(word));
+                    return true;
+                }
+                default: {
+                    auto it = std::lower_bound(runs.begin(), runs.end(), x,
+                                               [](const Run& run, uint32_t val) { return run.last < val; });
+                    if (it == runs.end()) {
+                        return false;
+                    }
+                    ans = static_cast<uint16_t>(std::max<uint32_t>(x, it->first));
+                    return true;
+                }
+            }
+        }
+
+        // Finds the highest key <= x.
+        bool prev(int32_t x, uint16_t& ans) const {
+            if (x < 0) {
+                return false;
+            }
+            switch (type) {
+                case ARRAY: {
+                    auto it = std::upper_bound(array.begin(), array.end(), x);
+                    if (it == array.begin()) {
+                        return false;
+                    }
+                    ans = *std::prev(it);
+                    return true;
+                }
+                case BITMAP: {
+                    size_t i = x / WORD;
+                    uint64_t word = bitmap[i] & (~uint64_t(0) >> (WORD - 1 - x % WORD));
+                    while (word == 0) {
+                        if (i == 0) {
+                            return false;
+                        }
+                        word = bitmap[--i];
+                    }
+                    ans = static_cast<uint16_t>(i * WORD + WORD - 1 - __builtin_clzll(word));
+                    return true;
+                }
+                default: {
+                    auto it = run_after(static_cast<uint16_t>(x));
+                    if (it == runs.begin()) {
+                        return false;
+                    }
+                    ans = std::min<uint16_t>(static_cast<uint16_t>(x), std::prev(it)->last);
+                    return true;
+                }
+            }
+        }
+
+        uint16_t min() const {
+            uint16_t ans = 0;
+            lower_bound(0, ans);
+            return ans;
+        }
+
+        uint16_t max() const {
+            uint16_t ans = 0;
+            prev(UINT16_MAX, ans);
+            return ans;
+        }
+
+        // Chooses the smallest representation.
+        void optimize() {
+            size_t run_count = count_runs();
+            size_t run_bytes = run_count * sizeof(Run);
+            if (run_bytes < plain_bytes()) {
+                to_runs();
+            } else if (cardinality <= ARRAY_MAX) {
+                to_array();
+            } else {
+                to_bitmap();
+            }
+        }
+
+        static Container unite(const Container& a, const Container& b) {
+            Container result;
+            if (a.type == ARRAY && b.type == ARRAY && a.cardinality + b.cardinality <= ARRAY_MAX) {
+                std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                               std::back_inserter(result.array));
+                result.cardinality = static_cast<uint32_t>(result.array.size());
+                return result;
+            }
+            result.bitmap = a.bitmap_words();
+            b.add_to_bitmap(result.bitmap);
+            result.type = BITMAP;
+            result.recount();
+            return result;
+        }
+
+        static Container intersect(const Container& a, const Container& b) {
+            Container result;
+            if (a.type == ARRAY || b.type == ARRAY) {
+                const Container& small = a.type == ARRAY ? a : b;
+                const Container& other = a.type == ARRAY ? b : a;
+                for (uint16_t x : small.array) {
+                    if (other.contains(x)) {
+                        result.array.push_back(x);
+                    }
+                }
+                result.cardinality = static_cast<uint32_t>(result.array.size());
+                return result;
+            }
+            result.bitmap = a.bitmap_words();
+            std::vector<uint64_t> other = b.bitmap_words();
+            // Plain word loop, which compiler vectorizes.
+            for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+                result.bitmap[i] &= other[i];
+            }
+            result.type = BITMAP;
+            result.recount();
+            return result;
+        }
+
+      private:
+        // Bytes of array or bitmap, whichever suits cardinality.
+        size_t plain_bytes() const {
+            return cardinality <= ARRAY_MAX ? cardinality * sizeof(uint16_t) : BITMAP_WORDS * sizeof(uint64_t);
+        }
+
+        // Leaves run representation, once inserts and erases have broken runs, so that it isn't the smallest.
+        void leave_runs_if_larger() {
+            if (runs.size() * sizeof(Run) <= plain_bytes()) {
+                return;
+            }
+            if (cardinality <= ARRAY_MAX) {
+                to_array();
+            } else {
+                to_bitmap();
+            }
+        }
+
+        // First run, which starts after x.
+        std::vector<Run>::const_iterator run_after(uint16_t x) const {
+            return std::upper_bound(runs.begin(), runs.end(), x,
+                                    [](uint16_t val, const Run& run) { return val < run.first; });
+        }
+
+        bool insert_into_runs(uint16_t x) {
+            auto next = runs.begin() + (run_after(x) - runs.cbegin());
+            bool joins_prev = next != runs.begin() && std::prev(next)->last + 1 >= x;
+            if (joins_prev && std::prev(next)->last >= x) {
+                return false;
+            }
+            bool joins_next = next != runs.end() && x + 1 == next->first;
+            if (joins_prev && joins_next) {
+                std::prev(next)->last = next->last;
+                runs.erase(next);
+            } else if (joins_prev) {
+                std::prev(next)->last = x;
+            } else if (joins_next) {
+                next->first = x;
+            } else {
+                runs.insert(next, Run{x, x});
+            }
+            ++cardinality;
+            leave_runs_if_larger();
+            return true;
+        }
+
+        bool erase_from_runs(uint16_t x) {
+            auto next = runs.begin() + (run_after(x) - runs.cbegin());
+            if (next == runs.begin() || std::prev(next)->last < x) {
+                return false;
+            }
+            auto run = std::prev(next);
+            if (run->first == run->last) {
+                runs.erase(run);
+            } else if (run->first == x) {
+                ++run->first;
+            } else if (run->last == x) {
+                --run->last;
+            } else {
+                Run upper{static_cast<uint16_t>(x + 1), run->last};
+                run->last = static_cast<uint16_t>(x - 1);
+                runs.insert(next, upper);
+            }
+            --cardinality;
+            leave_runs_if_larger();
+            return true;
+        }
+
+        size_t count_runs() const {
+            size_t count = 0;
+            switch (type) {
+                case ARRAY:
+                    for (size_t i = 0; i < array.size(); ++i) {
+                        count += i == 0 || array[i - 1] + 1 != array[i];
+                    }
+                    return count;
+                case BITMAP: {
+                    // Run starts at every set bit, whose lower neighbour isn't set.
+                    uint64_t carry = 0;
+                    for (uint64_t word : bitmap) {
+                        count += __builtin_popcountll(word & ~(word << 1 | carry));
+                        carry = word >> (WORD - 1);
+                    }
+                    return count;
+                }
+                default:
+                    return runs.size();
+            }
+        }
+
+        std::vector<uint64_t> bitmap_words() const {
+            std::vector<uint64_t> words(BITMAP_WORDS);
+            add_to_bitmap(words);
+            return words;
+        }
+
+        void add_to_bitmap(std::vector<uint64_t>& words) const {
+            switch (type) {
+                case ARRAY:
+                    for (uint16_t x : array) {
+                        words[x / WORD] |= uint64_t(1) << (x % WORD);
+                    }
+                    break;
+                case BITMAP:
+                    // Plain word loop, which compiler vectorizes.
+                    for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+                        words[i] |= bitmap[i];
+                    }
+                    break;
+                default:
+                    for (const Run& run : runs) {
+                        for (uint32_t x = run.first; x <= run.last; ++x) {
+                            words[x / WORD] |= uint64_t(1) << (x % WORD);
+                        }
+                    }
+            }
+        }
+
+        // Recounts bitmap cardinality and switches to array, if it is sparse.
+        void recount() {
+            cardinality = 0;
+            for (uint64_t word : bitmap) {
+                cardinality += __builtin_popcountll(word);
+            }
+            if (cardinality <= ARRAY_MAX) {
+                to_array();
+            }
+        }
+
+        void to_bitmap() {
+            if (type == BITMAP) {
+                return;
+            }
+            bitmap = bitmap_words();
+            array.clear();
+            array.shrink_to_fit();
+            runs.clear();
+            runs.shrink_to_fit();
+            type = BITMAP;
+        }
+
+        void to_array() {
+            if (type == ARRAY) {
+                return;
+            }
+            std::vector<uint16_t> keys;
+            keys.reserve(cardinality);
+            uint16_t x;
+            for (bool found = lower_bound(0, x); found; found = lower_bound(uint32_t(x) + 1, x)) {
+                keys.push_back(x);
+            }
+            array = std::move(keys);
+            bitmap.clear();
+            bitmap.shrink_to_fit();
+            runs.clear();
+            runs.shrink_to_fit();
+            type = ARRAY;
+        }
+
+        void to_runs() {
+            if (type == RUN) {
+                return;
+            }
+            std::vector<Run> ranges;
+            uint16_t x;
+            for (bool found = lower_bound(0, x); found; found = lower_bound(uint32_t(x) + 1, x)) {
+                if (!ranges.empty() && ranges.back().last + 1 == x) {
+                    ranges.back().last = x;
+                } else {
+                    ranges.push_back(Run{x, x});
+                }
+            }
+            runs = std::move(ranges);
+            array.clear();
+            array.shrink_to_fit();
+            bitmap.clear();
+            bitmap.shrink_to_fit();
+            type = RUN;
+        }
+    };
+
+    using Chunk = std::pair<uint16_t, Container>;
+
+  public:
+    /*
+     * Bidirectional iterator over keys
+     * Doesn't support random access
+     * Prefix/postfix increment/decrement works in O(container operation)
+     * */
+    class iterator {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = uint32_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint32_t*;
+        using reference = uint32_t;
+
+        iterator() = default;
+
+        bool operator==(const iterator& it) const { return it.chunk == chunk && it.low_bits == low_bits; }
+
+        bool operator!=(const iterator& it) const { return !(*this == it); }
+
+        uint32_t operator*() const { return uint32_t(set->chunks[chunk].first) << HIGH_SHIFT | low_bits; }
+
+        iterator& operator++() {
+            if (!set->chunks[chunk].second.lower_bound(uint32_t(low_bits) + 1, low_bits)) {
+                low_bits = ++chunk < set->chunks.size() ? set->chunks[chunk].second.min() : 0;
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        iterator& operator--() {
+            if (chunk == set->chunks.size() || !set->chunks[chunk].second.prev(int32_t(low_bits) - 1, low_bits)) {
+                low_bits = set->chunks[--chunk].second.max();
+            }
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+
+      private:
+        iterator(const RoaringSet* set_, size_t chunk_, uint16_t low_bits_)
+            : set(set_), chunk(chunk_), low_bits(low_bits_) {}
+
+        const RoaringSet* set = nullptr;
+        size_t chunk = 0;
+        uint16_t low_bits = 0;
+
+        friend class RoaringSet;
+    };
+
+  private:
+    static uint16_t high(uint32_t val) { return static_cast<uint16_t>(val >> HIGH_SHIFT); }
+
+    static uint16_t low(uint32_t val) { return static_cast<uint16_t>(val); }
+
+    // Index of the first chunk with upper bits >= key.
+    size_t chunk_position(uint16_t key) const {
+        return std::lower_bound(chunks.begin(), chunks.end(), key,
+                                [](const Chunk& chunk, uint16_t val) { return chunk.first < val; }) -
+               chunks.begin();
+    }
+
+    void recount() {
+        element_count = 0;
+        for (const Chunk& chunk : chunks) {
+            element_count += chunk.second.cardinality;
+        }
+    }
+
+    static constexpr uint32_t HIGH_SHIFT = 16;
+    static constexpr size_t WORD = 64;
+    static constexpr size_t BITMAP_WORDS = (1 << 16) / WORD;
+    static constexpr uint32_t ARRAY_MAX = 4096;
+
+    std::vector<Chunk> chunks;
+    size_t element_count = 0;
+};
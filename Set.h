@@ -1,3 +1,670 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Raw storage for nodes, placed right inside Set object.
+template<class Node, size_t Capacity>
+struct SetInlineNodes {
+    Node* nodes() { return reinterpret_cast<Node*>(data); }
+
+    alignas(Node) unsigned char data[Capacity * sizeof(Node)];
+};
+
+template<class Node>
+struct SetInlineNodes<Node, 0> {
+    Node* nodes() { return nullptr; }
+};
+
+/*
+ * Thread, which tears down storage, handed over by sets with background teardown, in order of arrival.
+ * Sets share one instance: it lives, while any of them or the program holds it, and its destructor
+ * finishes queued teardowns and joins the thread.
+ */
+class SetReaper {
+  public:
+    // Starts the thread on first call. Throws std::system_error, if it can't be started.
+    static std::shared_ptr<SetReaper> instance() {
+        static std::shared_ptr<SetReaper> shared = std::make_shared<SetReaper>();
+        return shared;
+    }
+
+    SetReaper() : worker([this]() { run(); }) {}
+
+    SetReaper(const SetReaper&) = delete;
+
+    SetReaper& operator=(const SetReaper&) = delete;
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+            ++posted;
+        }
+        changed.notify_all();
+    }
+
+    // Waits for teardowns, posted so far, to finish.
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t target = posted;
+        changed.wait(lock, [this, target]() { return finished >= target; });
+    }
+
+    ~SetReaper() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+  private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            task = nullptr;
+            lock.lock();
+            ++finished;
+            changed.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::function<void()>> tasks;
+    uint64_t posted = 0;
+    uint64_t finished = 0;
+    bool stopping = false;
+    // Started last, once the state above is ready.
+    std::thread worker;
+};
+
+/*
+ * Key data, cached inside nodes to decide comparisons without touching the key itself.
+ * By default nothing is cached and comparisons go straight to operator <.
+ * Probe is the searched key, prepared once per operation.
+ */
+template<class T>
+class SetKeyPrefix {
+  public:
+    struct Inline {};
+
+    struct Probe {
+        const T& key;
+    };
+
+    Probe probe(const T& key) const { return Probe{key}; }
+
+    static bool less(const Probe& probe, const Inline&, const T& val) { return probe.key < val; }
+
+    static bool greater(const Probe& probe, const Inline&, const T& val) { return val < probe.key; }
+
+    // Called before key is added. Returns true, if cached data of all nodes must be recomputed.
+    bool admit(const T&, bool) { return false; }
+
+    // Prepares for keys in range [first, last], which are added in bulk.
+    void reset(const T&, const T&) {}
+
+    void assign(Inline&, const T&) const {}
+};
+
+/*
+ * Strings cache 16 bytes of key in node as two big-endian words, so that comparing words
+ * gives the same order as comparing strings. As keys, like URLs, often share long prefix,
+ * cached bytes are taken right after the prefix, common for all keys of the set.
+ * If searched key diverges from the set inside that prefix, it is less or greater than
+ * all keys at once. String buffer is read only when cached words are equal.
+ * Shortening of common prefix recomputes all nodes, which happens at most once per its byte.
+ */
+template<>
+class SetKeyPrefix<std::string> {
+  public:
+    struct Inline {
+        uint64_t high = 0;
+        uint64_t low = 0;
+    };
+
+    struct Probe {
+        const std::string& key;
+        uint64_t high;
+        uint64_t low;
+        // -1 or 1, if key is less or greater than all keys of the set, otherwise 0.
+        int order;
+    };
+
+    Probe probe(const std::string& key) const {
+        size_t common = common_length(key, reference, skip);
+        if (common < skip) {
+            bool less = common == key.size() || byte(key, common) < byte(reference, common);
+            return Probe{key, 0, 0, less ? -1 : 1};
+        }
+        Inline words = make(key);
+        return Probe{key, words.high, words.low, 0};
+    }
+
+    static bool less(const Probe& probe, const Inline& node, const std::string& val) {
+        if (probe.order != 0) {
+            return probe.order < 0;
+        }
+        if (probe.high != node.high) {
+            return probe.high < node.high;
+        }
+        if (probe.low != node.low) {
+            return probe.low < node.low;
+        }
+        return probe.key < val;
+    }
+
+    static bool greater(const Probe& probe, const Inline& node, const std::string& val) {
+        if (probe.order != 0) {
+            return probe.order > 0;
+        }
+        if (probe.high != node.high) {
+            return node.high < probe.high;
+        }
+        if (probe.low != node.low) {
+            return node.low < probe.low;
+        }
+        return val < probe.key;
+    }
+
+    bool admit(const std::string& key, bool empty) {
+        if (empty) {
+            reference = key;
+            skip = key.size();
+            return false;
+        }
+        size_t common = common_length(key, reference, skip);
+        if (common < skip) {
+            skip = common;
+            return true;
+        }
+        return false;
+    }
+
+    // Common prefix of sorted keys is the common prefix of the first and the last ones.
+    void reset(const std::string& first, const std::string& last) {
+        reference = first;
+        skip = common_length(first, last, first.size());
+    }
+
+    void assign(Inline& node, const std::string& key) const { node = make(key); }
+
+  private:
+    static constexpr size_t WORD = 8;
+
+    static unsigned char byte(const std::string& s, size_t i) { return static_cast<unsigned char>(s[i]); }
+
+    static size_t common_length(const std::string& a, const std::string& b, size_t limit) {
+        size_t n = a.size() < limit ? a.size() : limit;
+        n = b.size() < n ? b.size() : n;
+        size_t i = 0;
+        while (i < n && a[i] == b[i]) {
+            ++i;
+        }
+        return i;
+    }
+
+    // Missing bytes are zeros: shorter key is a prefix of longer one, so order is kept.
+    Inline make(const std::string& key) const {
+        Inline words;
+        for (size_t i = 0; i < WORD; ++i) {
+            size_t pos = skip + i;
+            words.high = words.high << 8 | (pos < key.size() ? byte(key, pos) : 0);
+        }
+        for (size_t i = 0; i < WORD; ++i) {
+            size_t pos = skip + WORD + i;
+            words.low = words.low << 8 | (pos < key.size() ? byte(key, pos) : 0);
+        }
+        return words;
+    }
+
+    // Some key, which had been in the set. Its first skip bytes are shared by all keys of the set.
+    std::string reference;
+    size_t skip = 0;
+};
+
+/*
+ * Balancing policies of Set. Each one keeps its balance information in node's height field
+ * and restores balance bottom-up by parent links after a leaf is attached or a node is unlinked:
+ * - after_insert(node, header): node is a fresh leaf;
+ * - after_erase(parent, child, is_left, removed, header): child took place of removed node,
+ *   whose balance information is removed, on the is_left side of parent;
+ * - built(node, depth, last_level): initializes node of perfectly balanced tree bottom-up;
+ * - after_access(node, header): node is found by lookup.
+ * Header is the sentinel, whose left child is the root of tree.
+ */
+struct SetRotations {
+    template<class Node>
+    static void after_access(Node*, Node*) {}
+
+    // Rotations relink parent of node too. Sentinel is parent of the root, so it is never null.
+    template<class Node>
+    static Node* rotate_left(Node* node) {
+        Node* top = node->right;
+        node->right = top->left;
+        if (top->left) {
+            top->left->parent = node;
+        }
+        replace_child(node, top);
+        top->left = node;
+        node->parent = top;
+        return top;
+    }
+
+    template<class Node>
+    static Node* rotate_right(Node* node) {
+        Node* top = node->left;
+        node->left = top->right;
+        if (top->right) {
+            top->right->parent = node;
+        }
+        replace_child(node, top);
+        top->right = node;
+        node->parent = top;
+        return top;
+    }
+
+  private:
+    template<class Node>
+    static void replace_child(Node* node, Node* top) {
+        top->parent = node->parent;
+        if (node->parent->left == node) {
+            node->parent->left = top;
+        } else {
+            node->parent->right = top;
+        }
+    }
+};
+
+// Subtree heights differ by at most one. Height is stored, -1 for null.
+struct AvlBalance : SetRotations {
+    template<class Node>
+    static void after_insert(Node* node, Node* header) {
+        node->height = 0;
+        rebalance_upward(node->parent, header);
+    }
+
+    template<class Node>
+    static void after_erase(Node* parent, Node*, bool, int32_t, Node* header) {
+        rebalance_upward(parent, header);
+    }
+
+    template<class Node>
+    static void built(Node* node, int32_t, int32_t) {
+        update_height(node);
+    }
+
+  private:
+    template<class Node>
+    static int32_t get_height(Node* node) {
+        return node == nullptr ? -ONE : node->height;
+    }
+
+    template<class Node>
+    static int32_t height_difference(Node* node) {
+        return get_height(node->left) - get_height(node->right);
+    }
+
+    template<class Node>
+    static void update_height(Node* node) {
+        node->height = 1 + std::max(get_height(node->left), get_height(node->right));
+    }
+
+    // Standard AVL's rotate implementation. Returns the new top of subtree.
+    template<class Node>
+    static Node* rotate(Node* node) {
+        int32_t n_diff = height_difference(node);
+        if (n_diff == -TWO) {
+            if (height_difference(node->right) == ONE) {
+                rotate_right(node->right);
+                update_height(node->right->right);
+            }
+            Node* top = rotate_left(node);
+            update_height(node);
+            update_height(top);
+            return top;
+        }
+        if (n_diff == TWO) {
+            if (height_difference(node->left) == -ONE) {
+                rotate_left(node->left);
+                update_height(node->left->left);
+            }
+            Node* top = rotate_right(node);
+            update_height(node);
+            update_height(top);
+            return top;
+        }
+        return node;
+    }
+
+    // Fixes heights and rotates on the path from node up. Stops once subtree height is unchanged.
+    template<class Node>
+    static void rebalance_upward(Node* node, Node* header) {
+        while (node != header) {
+            int32_t old_height = node->height;
+            update_height(node);
+            Node* top = rotate(node);
+            if (top->height == old_height) {
+                return;
+            }
+            node = top->parent;
+        }
+    }
+
+    static constexpr int32_t ONE = 1;
+    static constexpr int32_t TWO = 2;
+};
+
+/*
+ * Red-black tree: height field holds color. Insertion makes at most two rotations,
+ * erasure at most three, recoloring is amortized O(1).
+ */
+struct RedBlackBalance : SetRotations {
+    template<class Node>
+    static void after_insert(Node* node, Node* header) {
+        node->height = RED;
+        while (node->parent != header && node->parent->height == RED) {
+            // Parent is red, so it isn't the root, and grandparent exists.
+            Node* parent = node->parent;
+            Node* grand = parent->parent;
+            bool parent_is_left = grand->left == parent;
+            Node* uncle = parent_is_left ? grand->right : grand->left;
+            if (uncle && uncle->height == RED) {
+                parent->height = BLACK;
+                uncle->height = BLACK;
+                grand->height = RED;
+                node = grand;
+                continue;
+            }
+            if (parent_is_left) {
+                if (parent->right == node) {
+                    rotate_left(parent);
+                    parent = node;
+                }
+                rotate_right(grand);
+            } else {
+                if (parent->left == node) {
+                    rotate_right(parent);
+                    parent = node;
+                }
+                rotate_left(grand);
+            }
+            parent->height = BLACK;
+            grand->height = RED;
+            break;
+        }
+        header->left->height = BLACK;
+    }
+
+    template<class Node>
+    static void after_erase(Node* parent, Node* child, bool is_left, int32_t removed, Node* header) {
+        if (removed == RED) {
+            return;
+        }
+        if (child && child->height == RED) {
+            child->height = BLACK;
+            return;
+        }
+        // Subtree on the is_left side of parent lacks one black node. Sibling surely exists.
+        while (parent != header) {
+            if (is_left) {
+                Node* sibling = parent->right;
+                if (sibling->height == RED) {
+                    sibling->height = BLACK;
+                    parent->height = RED;
+                    rotate_left(parent);
+                    sibling = parent->right;
+                }
+                if (is_black(sibling->left) && is_black(sibling->right)) {
+                    sibling->height = RED;
+                } else {
+                    if (is_black(sibling->right)) {
+                        sibling->left->height = BLACK;
+                        sibling->height = RED;
+                        sibling = rotate_right(sibling);
+                    }
+                    sibling->height = parent->height;
+                    parent->height = BLACK;
+                    sibling->right->height = BLACK;
+                    rotate_left(parent);
+                    return;
+                }
+            } else {
+                Node* sibling = parent->left;
+                if (sibling->height == RED) {
+                    sibling->height = BLACK;
+                    parent->height = RED;
+                    rotate_right(parent);
+                    sibling = parent->left;
+                }
+                if (is_black(sibling->left) && is_black(sibling->right)) {
+                    sibling->height = RED;
+                } else {
+                    if (is_black(sibling->left)) {
+                        sibling->right->height = BLACK;
+                        sibling->height = RED;
+                        sibling = rotate_left(sibling);
+                    }
+                    sibling->height = parent->height;
+                    parent->height = BLACK;
+                    sibling->left->height = BLACK;
+                    rotate_right(parent);
+                    return;
+                }
+            }
+            // Both subtrees of parent lack black node now: red parent becomes black, or problem goes up.
+            if (parent->height == RED) {
+                parent->height = BLACK;
+                return;
+            }
+            Node* node = parent;
+            parent = node->parent;
+            is_left = parent->left == node;
+        }
+    }
+
+    // Perfectly balanced tree has all levels full except the last one, whose nodes are red.
+    template<class Node>
+    static void built(Node* node, int32_t depth, int32_t last_level) {
+        node->height = depth == last_level && depth > 0 ? RED : BLACK;
+    }
+
+  private:
+    template<class Node>
+    static bool is_black(Node* node) {
+        return node == nullptr || node->height == BLACK;
+    }
+
+    static constexpr int32_t RED = 0;
+    static constexpr int32_t BLACK = 1;
+};
+
+/*
+ * Weak AVL tree: height field holds rank, -1 for null. Rank differences of children are 1 or 2,
+ * leaves have rank 0. Without erasures tree is AVL, with them it is still no higher than red-black one.
+ * Any update makes at most two rotations, rank changes are amortized O(1).
+ */
+struct WavlBalance : SetRotations {
+    template<class Node>
+    static void after_insert(Node* node, Node* header) {
+        node->height = 0;
+        // Node is 0-child of its parent, while they have equal ranks.
+        while (node->parent != header && node->parent->height == node->height) {
+            Node* parent = node->parent;
+            bool is_left = parent->left == node;
+            Node* sibling = is_left ? parent->right : parent->left;
+            if (parent->height - rank(sibling) == 1) {
+                ++parent->height;
+                node = parent;
+                continue;
+            }
+            Node* inner = is_left ? node->right : node->left;
+            if (node->height - rank(inner) == 2) {
+                is_left ? rotate_right(parent) : rotate_left(parent);
+                --parent->height;
+            } else {
+                if (is_left) {
+                    rotate_left(node);
+                    rotate_right(parent);
+                } else {
+                    rotate_right(node);
+                    rotate_left(parent);
+                }
+                ++inner->height;
+                --node->height;
+                --parent->height;
+            }
+            return;
+        }
+    }
+
+    template<class Node>
+    static void after_erase(Node* parent, Node* child, bool is_left, int32_t, Node* header) {
+        if (parent == header) {
+            return;
+        }
+        Node* node = child;
+        // Leaf with rank 1 would be 2,2-leaf.
+        if (parent->left == nullptr && parent->right == nullptr) {
+            parent->height = 0;
+            node = parent;
+            parent = node->parent;
+            is_left = parent->left == node;
+        }
+        // Node is 3-child of its parent.
+        while (parent != header && parent->height - rank(node) == 3) {
+            Node* sibling = is_left ? parent->right : parent->left;
+            if (parent->height - rank(sibling) == 2) {
+                --parent->height;
+            } else {
+                Node* outer = is_left ? sibling->right : sibling->left;
+                Node* inner = is_left ? sibling->left : sibling->right;
+                if (sibling->height - rank(outer) == 2 && sibling->height - rank(inner) == 2) {
+                    --parent->height;
+                    --sibling->height;
+                } else if (sibling->height - rank(outer) == 1) {
+                    is_left ? rotate_left(parent) : rotate_right(parent);
+                    ++sibling->height;
+                    --parent->height;
+                    if (parent->left == nullptr && parent->right == nullptr) {
+                        --parent->height;
+                    }
+                    return;
+                } else {
+                    if (is_left) {
+                        rotate_right(sibling);
+                        rotate_left(parent);
+                    } else {
+                        rotate_left(sibling);
+                        rotate_right(parent);
+                    }
+                    inner->height += 2;
+                    --sibling->height;
+                    parent->height -= 2;
+                    return;
+                }
+            }
+            node = parent;
+            parent = node->parent;
+            is_left = parent->left == node;
+        }
+    }
+
+    // Heights of perfectly balanced tree are valid ranks.
+    template<class Node>
+    static void built(Node* node, int32_t, int32_t) {
+        node->height = 1 + std::max(rank(node->left), rank(node->right));
+    }
+
+  private:
+    template<class Node>
+    static int32_t rank(Node* node) {
+        return node == nullptr ? -1 : node->height;
+    }
+};
+
+/*
+ * Splay tree: inserted and found keys are moved to the root, so frequently accessed keys stay
+ * near the top. Operations work in amortized O(log(tree_size)), single one may take O(tree_size).
+ * Lookups restructure the tree, so even const methods must not run concurrently.
+ */
+struct SplayBalance : SetRotations {
+    template<class Node>
+    static void after_insert(Node* node, Node* header) {
+        splay(node, header);
+    }
+
+    template<class Node>
+    static void after_erase(Node* parent, Node*, bool, int32_t, Node* header) {
+        if (parent != header) {
+            splay(parent, header);
+        }
+    }
+
+    template<class Node>
+    static void built(Node*, int32_t, int32_t) {}
+
+    template<class Node>
+    static void after_access(Node* node, Node* header) {
+        splay(node, header);
+    }
+
+  private:
+    // Lifts node over its parent.
+    template<class Node>
+    static void lift(Node* node) {
+        if (node->parent->left == node) {
+            rotate_right(node->parent);
+        } else {
+            rotate_left(node->parent);
+        }
+    }
+
+    template<class Node>
+    static void splay(Node* node, Node* header) {
+        while (node->parent != header) {
+            Node* parent = node->parent;
+            if (parent->parent != header) {
+                // Zig-zig rotates parent first, zig-zag rotates node twice.
+                bool same_side = (parent->left == node) == (parent->parent->left == parent);
+                lift(same_side ? parent : node);
+            }
+            lift(node);
+        }
+    }
+};
+
 /*
  * Template analogue of std::set, based on AVL tree.
  * Template type must have operator <.
@@ -6,16 +673,21 @@
  * - erase
  * - find
  * - lower_bound
+ * First InlineCapacity nodes are stored inside Set object itself, so small sets make no allocations.
+ * It is 0 by default, as every slot adds the size of node to every Set object, used or not: callers,
+ * keeping many small sets, opt in with the expected size, e.g. Set<int, 8>.
+ * Empty set never allocates.
+ * Balance selects the balancing scheme: AvlBalance, RedBlackBalance, WavlBalance or SplayBalance.
+ * Red-black and WAVL do amortized O(1) restructuring per update, which suits erase-heavy workloads.
+ * Splay keeps recently accessed keys near the root, which suits skewed lookups.
  */
-template<class T>
+template<class T, size_t InlineCapacity = 0, class Balance = AvlBalance>
 class Set {
   public:
     
-    // Invariant of root!=null is needed for always having node, representing end() iterator.
-    Set() { root = new Node(); }
+    Set() = default;
 
-    Set(const Set<T>& other) {
-        root = new Node();
+    Set(const Set& other) {
         for (const T& val : other) {
             insert(val);
         }
@@ -27,8 +699,6 @@ class Set {
             return *this;
         }
         destroy();
-        root->left = nullptr;
-        node_count = 0;
         for (T val : other) {
             insert(val);
         }
@@ -36,7 +706,6 @@ class Set {
     }
 
     Set(const std::initializer_list<T>& elems) {
-        root = new Node();
         for (const T& val : elems) {
             insert(val);
         }
@@ -44,7 +713,6 @@ class Set {
 
     template<typename Iterator>
     Set(const Iterator first, const Iterator last) {
-        root = new Node();
         for (Iterator it = first; it != last; ++it) {
             insert(*it);
         }
@@ -54,72 +722,589 @@ class Set {
 
     // If needed value exists, returns iterator on corresponding node, otherwise end().
     iterator find(const T& val) const {
+        sync();
+        BloomFilter* filter = bloom_filter();
+        if (filter && !filter->may_contain(val)) {
+            ++filter->rejected;
+            return end();
+        }
+        Node** slot = nullptr;
+        LookupCache* cache = lookup_cache();
+        if (cache) {
+            slot = cache->slot(val);
+            Node* hit = *slot;
+            if (hit != nullptr && !(val < hit->value) && !(hit->value < val)) {
+                ++cache->stats.hits;
+                Balance::after_access(hit, root);
+                return iterator(hit);
+            }
+            ++cache->stats.misses;
+        }
+        Probe probe = key_prefix.probe(val);
         Node* cur = root->left;
         while (cur != nullptr) {
-            if (val < cur->value) {
+            if (probe_less(probe, cur)) {
                 cur = cur->left;
-            } else if (cur->value < val) {
+            } else if (node_less(cur, probe)) {
                 cur = cur->right;
+            } else if (cur->deleted) {
+                break;
             } else {
+                if (slot) {
+                    *slot = cur;
+                }
+                Balance::after_access(cur, root);
                 return iterator(cur);
             }
         }
+        if (filter) {
+            ++filter->false_positives;
+        }
         return end();
     }
 
+    bool contains(const T& val) const { return find(val) != end(); }
+
+    struct LookupCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    /*
+     * Enables direct-mapped cache of found nodes in front of find(), so that repeated lookups
+     * of hot keys skip the descent. Number of entries is rounded up to power of two, 0 disables cache.
+     * Hash is used only by cache, so it is needed only when cache is enabled.
+     * Lookups fill cache entries and count stats, so with cache even const methods must not run concurrently.
+     */
+    template<typename Hash = std::hash<T>>
+    void set_lookup_cache(size_t entries) {
+        if (entries == 0) {
+            if (extras) {
+                extras->cache.reset();
+            }
+            return;
+        }
+        extra().cache.reset(new LookupCache(entries, [](const T& val) { return static_cast<uint64_t>(Hash()(val)); }));
+    }
+
+    // Hits and misses of lookup cache since it was enabled.
+    LookupCacheStats lookup_cache_stats() const {
+        LookupCache* cache = lookup_cache();
+        return cache ? cache->stats : LookupCacheStats{0, 0};
+    }
+
+    struct BloomFilterStats {
+        // Bytes, taken by filter.
+        size_t memory;
+        // Lookups of absent keys, answered by filter alone.
+        uint64_t rejected;
+        // Lookups of absent keys, which filter let through to the tree.
+        uint64_t false_positives;
+        double false_positive_rate;
+    };
+
+    /*
+     * Enables blocked Bloom filter in front of find(), so that lookups of absent keys mostly
+     * return without descent. Each key sets bits inside one cache line of filter.
+     * Filter is rebuilt from the tree, when it gets full or erased keys reach an eighth of its capacity.
+     * 0 bits per key disables filter.
+     * Lookups count stats, so with filter even const methods must not run concurrently.
+     */
+    template<typename Hash = std::hash<T>>
+    void set_bloom_filter(size_t bits_per_key) {
+        if (bits_per_key == 0) {
+            if (extras) {
+                extras->filter.reset();
+            }
+            return;
+        }
+        extra().filter.reset(new BloomFilter(bits_per_key, [](const T& val) { return static_cast<uint64_t>(Hash()(val)); }));
+        rebuild_filter();
+    }
+
+    BloomFilterStats bloom_filter_stats() const {
+        BloomFilter* filter = bloom_filter();
+        if (!filter) {
+            return BloomFilterStats{0, 0, 0, 0};
+        }
+        uint64_t negatives = filter->rejected + filter->false_positives;
+        return BloomFilterStats{sizeof(BloomFilter) + filter->storage.size() * sizeof(uint64_t), filter->rejected,
+                                filter->false_positives,
+                                negatives == 0 ? 0 : double(filter->false_positives) / double(negatives)};
+    }
+
     // Returns iterator on node with the lowest key >= val.
     iterator lower_bound(const T& val) const {
-        Node* cur = root->left;
-        Node* ans = root;
-        while (cur) {
-            if (cur->value < val) {
-                cur = cur->right;
-            } else {
-                ans = cur;
-                cur = cur->left;
-            }
+        sync();
+        Node* ans = skip_deleted(descend(root->left, root, key_prefix.probe(val)));
+        if (ans != root) {
+            Balance::after_access(ans, root);
         }
         return iterator(ans);
     }
 
+    /*
+     * Finger search: same as lower_bound(val), but starts from hint and climbs by parent links
+     * only as far as needed. Works in O(1), when answer is hint itself or val is past the maximum.
+     */
+    iterator lower_bound(iterator hint, const T& val) const {
+        sync();
+        return iterator(skip_deleted(finger_lower_bound(hint.node, key_prefix.probe(val))));
+    }
+
+    /*
+     * Lookups by the first component of tuple-like keys, e.g. std::pair or std::tuple,
+     * which are compared lexicographically. No key with filler components is built,
+     * and components are compared by reference. Work in O(log(tree_size)).
+     */
+    // Returns iterator on the lowest key, whose first component is >= first.
+    template<typename Prefix>
+    iterator lower_bound_prefix(const Prefix& first) const {
+        return iterator(partition_point([&first](const T& val) { return std::get<0>(val) < first; }));
+    }
+
+    // Returns iterator on the lowest key, whose first component is > first.
+    template<typename Prefix>
+    iterator upper_bound_prefix(const Prefix& first) const {
+        return iterator(partition_point([&first](const T& val) { return !(first < std::get<0>(val)); }));
+    }
+
+    // Returns range of all keys, whose first component is equal to first.
+    template<typename Prefix>
+    std::pair<iterator, iterator> equal_prefix_range(const Prefix& first) const {
+        return {lower_bound_prefix(first), upper_bound_prefix(first)};
+    }
+
     iterator begin() const {
+        sync();
         Node* ans = root;
         while (ans->left) {
             ans = ans->left;
         }
-        return iterator(ans);
+        return iterator(skip_deleted(ans));
+    }
+
+    iterator end() const { return iterator(root); }
+
+    // Inserts element in tree. If such exists, does nothing.
+    void insert(const T& val) {
+        if (extras && extras->write_limit > 0) {
+            buffer_write(val, true);
+            return;
+        }
+        admit(val);
+        Probe probe = key_prefix.probe(val);
+        Node* parent = root;
+        Node* cur = root->left;
+        bool is_left = true;
+        while (cur != nullptr) {
+            parent = cur;
+            if (probe_less(probe, cur)) {
+                cur = cur->left;
+                is_left = true;
+            } else if (node_less(cur, probe)) {
+                cur = cur->right;
+                is_left = false;
+            } else {
+                revive(cur);
+                return;
+            }
+        }
+        attach(parent, is_left, val);
+    }
+
+    /*
+     * Inserts element as close as possible to the position just prior to hint, like std::set does.
+     * Returns iterator on inserted element, or on the existing equal one.
+     * Works in amortized O(1), when element goes right before hint, e.g. appending with hint end().
+     * Pending buffered writes are flushed first, and then the hint is ignored, see set_write_buffer().
+     */
+    iterator insert(iterator hint, const T& val) {
+        if (extras && !extras->write_buffer.empty()) {
+            flush();
+            hint = end();
+        }
+        admit(val);
+        Probe probe = key_prefix.probe(val);
+        Node* next = finger_lower_bound(hint.node, probe);
+        if (next != root && !probe_less(probe, next)) {
+            revive(next);
+            return iterator(next);
+        }
+        return iterator(attach_before(next, val));
+    }
+
+    template<typename... Args>
+    iterator emplace_hint(iterator hint, Args&&... args) {
+        return insert(hint, T(std::forward<Args>(args)...));
+    }
+
+    // Erases element from tree. If such doesn't exist, does nothing.
+    void erase(const T& val) {
+        if (extras && extras->write_limit > 0) {
+            buffer_write(val, false);
+            return;
+        }
+        if (extras && extras->deleted_ratio > 0) {
+            mark_deleted(find(val).node);
+            return;
+        }
+        erase_node(find(val).node);
+    }
+
+    /*
+     * Erases element at pos, which must be dereferenceable. Returns iterator on the next element.
+     * Works in amortized O(1) plus rebalancing, when neither write buffer nor lazy erase is enabled.
+     * Otherwise it erases by key and finds the next element by descent.
+     */
+    iterator erase(iterator pos) {
+        if (extras && (extras->write_limit > 0 || extras->deleted_ratio > 0)) {
+            T val = *pos;
+            erase(val);
+            return lower_bound(val);
+        }
+        return iterator(erase_node(pos.node));
+    }
+
+    size_t size() const {
+        sync();
+        return node_count;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Removes all elements. Storage is released chunk by chunk, and nodes of trivially destructible type
+    // aren't visited at all.
+    void clear() { destroy(); }
+
+    /*
+     * Hands teardown of nodes in clear(), assignment, load and destructor over to SetReaper thread,
+     * so that the caller returns immediately. Nodes in inline storage live inside the Set object,
+     * so sets of non-trivially destructible type, using it, are still torn down in place.
+     * Turning it off waits for teardowns, handed over so far, so their memory is back after the call.
+     * Turning it on may throw std::system_error, if the thread can't be started.
+     */
+    void set_background_teardown(bool enabled) {
+        if (enabled) {
+            extra().reaper = SetReaper::instance();
+        } else if (extras && extras->reaper) {
+            extras->reaper->drain();
+            extras->reaper.reset();
+        }
+    }
+
+    /*
+     * Lazy erase mode: erase(val) only marks node as deleted in O(log(tree_size)), without unlinking
+     * and rebalancing, and inserting the key again revives the node. Once deleted nodes make more than
+     * max_ratio of the tree, it is rebuilt without them in O(tree_size). 0 turns the mode off, purging them.
+     */
+    void set_lazy_erase(double max_ratio) {
+        extra().deleted_ratio = max_ratio;
+        if (max_ratio <= 0 && deleted_count() > 0) {
+            purge_deleted();
+        }
+    }
+
+    /*
+     * Buffered write mode for insert bursts: insert(val) and erase(val) only append to buffer,
+     * which is applied by flush() once it holds limit writes, or before any read.
+     * Last write of each key wins. 0 turns the mode off, flushing the buffer.
+     * Reads flush pending writes, so with buffer even const methods (find, contains, size, iteration)
+     * change the tree and must not run concurrently, and a read after buffered writes invalidates iterators.
+     * insert(hint, val) and emplace_hint() return iterator, so they go straight to the tree: pending writes
+     * are flushed first, and then the hint, invalidated by flush(), is ignored.
+     */
+    void set_write_buffer(size_t limit) {
+        flush();
+        extra().write_limit = limit;
+    }
+
+    /*
+     * Applies buffered writes in ascending order of keys. Batch, comparable to the tree, is merged
+     * with it in one in-order pass, and the tree is rebuilt in O(tree_size + batch).
+     * Smaller batch is applied key by key with finger search. Invalidates all iterators.
+     */
+    void flush() {
+        if (!extras || extras->write_buffer.empty()) {
+            return;
+        }
+        std::vector<Write> writes;
+        writes.swap(extras->write_buffer);
+        std::stable_sort(writes.begin(), writes.end(), [](const Write& a, const Write& b) { return a.key < b.key; });
+        size_t kept = 0;
+        for (size_t i = 0; i < writes.size(); ++i) {
+            if (kept > 0 && !(writes[kept - 1].key < writes[i].key)) {
+                writes[kept - 1] = std::move(writes[i]);
+            } else {
+                if (kept != i) {
+                    writes[kept] = std::move(writes[i]);
+                }
+                ++kept;
+            }
+        }
+        writes.erase(writes.begin() + kept, writes.end());
+        if (writes.size() * BULK_FACTOR >= node_count) {
+            merge_writes(writes);
+            return;
+        }
+        // Keys of different writes differ, so erasures may go first, leaving hints valid.
+        for (const Write& write : writes) {
+            if (!write.insert) {
+                erase_node(find(write.key).node);
+            }
+        }
+        iterator hint = end();
+        for (const Write& write : writes) {
+            if (write.insert) {
+                hint = insert(hint, write.key);
+            }
+        }
+    }
+
+    /*
+     * Relocates all nodes into one contiguous block in in-order sequence, so that range iteration
+     * walks memory sequentially. Keys and tree shape are preserved. Invalidates all iterators.
+     */
+    void compact() {
+        while (!compact(std::numeric_limits<size_t>::max())) {
+        }
+    }
+
+    /*
+     * Incremental version of compact(): relocates at most max_moves nodes per call and returns true
+     * once compaction is finished. The set may be modified between calls.
+     * Each call invalidates all iterators.
+     */
+    bool compact(size_t max_moves) {
+        sync();
+        Node* cur;
+        if (!compacting()) {
+            if (deleted_count() > 0) {
+                purge_deleted();
+            }
+            if (root->left == nullptr) {
+                release_chunks();
+                return true;
+            }
+            if (chunks.empty()) {
+                return true;
+            }
+            // Slots of the old chunks are not reused any more: they are freed all at once in the end.
+            free_list = nullptr;
+            add_chunk(node_count);
+            Extras& state = extra();
+            state.compact_from = chunks.size() - 1;
+            state.compacting = true;
+            cur = get_leftest_node(root);
+        } else {
+            // Deleted nodes are relocated too, so they aren't skipped here.
+            cur = descend(root->left, root, key_prefix.probe(extras->compact_cursor));
+        }
+        for (size_t moved = 0; cur != root && moved < max_moves; ) {
+            Node* next = get_next_node(cur);
+            if (!is_compacted(cur)) {
+                relocate(cur);
+                ++moved;
+            }
+            cur = next;
+        }
+        if (cur != root) {
+            extras->compact_cursor = cur->value;
+            return false;
+        }
+        size_t compact_from = extras->compact_from;
+        for (size_t i = 0; i < compact_from; ++i) {
+            std::allocator<Node>().deallocate(chunks[i].nodes, chunks[i].capacity);
+        }
+        chunks.erase(chunks.begin(), chunks.begin() + compact_from);
+        inline_used = 0;
+        extras->compact_from = 0;
+        extras->compacting = false;
+        return true;
+    }
+
+    void shrink_to_fit() { compact(); }
+
+    /*
+     * Writes set in versioned binary format: header, element count and keys in ascending order.
+     * Keys of trivially copyable type are written as raw bytes in native byte order.
+     * Other types need custom serializer, called as serializer(out, value).
+     */
+    void save(std::ostream& out) const { save(out, RawSerializer()); }
+
+    template<typename Serializer>
+    void save(std::ostream& out, Serializer serializer) const {
+        sync();
+        Header header{MAGIC, VERSION, key_size(serializer), node_count};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (Node* cur = get_leftest_node(root); cur != root; cur = get_next_node(cur)) {
+            if (!cur->deleted) {
+                serializer(out, cur->value);
+            }
+        }
+        if (!out) {
+            throw std::runtime_error("Set::save: write failed");
+        }
+    }
+
+    void save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        save(out);
+    }
+
+    /*
+     * Replaces content of the set with one, written by save().
+     * Tree is built bottom-up from the sorted keys in O(n), without any comparisons and rotations.
+     * Custom deserializer is called as deserializer(in) and must return the key.
+     * Keys are read and validated before the set is touched, so on malformed input it stays unchanged,
+     * and std::runtime_error is thrown.
+     */
+    void load(std::istream& in) { load(in, RawSerializer()); }
+
+    template<typename Deserializer>
+    void load(std::istream& in, Deserializer deserializer) {
+        uint64_t size = key_size(deserializer);
+        uint64_t count = read_header(in, size);
+        // Count comes from the input, so memory is reserved only for keys, which the stream can hold.
+        uint64_t remaining = remaining_bytes(in);
+        if (size != 0 && count > remaining / size) {
+            throw std::runtime_error("Set::load: truncated data");
+        }
+        uint64_t limit = remaining == std::numeric_limits<uint64_t>::max() ? uint64_t(MAX_RESERVE) : remaining;
+        uint64_t reserved = count < limit ? count : limit;
+        std::vector<T> keys;
+        keys.reserve(static_cast<size_t>(reserved));
+        for (uint64_t i = 0; i < count; ++i) {
+            T val = deserializer(in);
+            if (!in || (!keys.empty() && !(keys.back() < val))) {
+                throw std::runtime_error("Set::load: corrupted data");
+            }
+            keys.push_back(std::move(val));
+        }
+        destroy();
+        // All nodes go to one chunk, so the loaded set is compact.
+        if (count > InlineCapacity) {
+            add_chunk(count);
+        }
+        Node head;
+        Node* tail = &head;
+        try {
+            for (const T& val : keys) {
+                tail->right = create_node(val);
+                tail = tail->right;
+            }
+        } catch (...) {
+            discard_chain(head.right);
+            throw;
+        }
+        build_from_chain(head.right, keys.size());
     }
 
-    iterator end() const { return iterator(root); }
-
-    // Inserts element in tree. If such exists, does nothing.
-    void insert(const T& val) {
-        root->left = recursive_insert(root->left, val);
-        root->left->parent = root;
+    void load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        load(in);
     }
 
-    // Erases element from tree. If such doesn't exist, does nothing.
-    void erase(const T& val) {
-        root->left = recursive_erase(root->left, val);
-        if (root->left) root->left->parent = root;
+    /*
+     * Replaces content of the set with union of several sorted runs, written by save().
+     * Runs are k-way merged with large buffered reads and deduplicated on the fly, and nodes
+     * go straight into the O(n) balanced build. The set is replaced only after all runs are read,
+     * so peak memory is the old and the new tree plus one buffer per run.
+     * Throws std::runtime_error on malformed input, leaving the set unchanged.
+     */
+    void load_merged(const std::vector<std::istream*>& inputs) {
+        std::vector<RunReader> runs;
+        runs.reserve(inputs.size());
+        for (std::istream* in : inputs) {
+            runs.emplace_back(*in);
+        }
+        // Merged nodes go to new chunks, detached from the current tree, which stays intact meanwhile.
+        std::vector<Chunk> kept_chunks;
+        kept_chunks.swap(chunks);
+        FreeSlot* kept_free_list = free_list;
+        size_t kept_inline_used = inline_used;
+        free_list = nullptr;
+        inline_used = InlineCapacity;
+        Node head;
+        Node* tail = &head;
+        size_t count = 0;
+        try {
+            // Heap of runs, ordered by their current keys.
+            std::vector<T> heads(runs.size());
+            std::vector<size_t> heap;
+            auto greater = [&heads](size_t a, size_t b) { return heads[b] < heads[a]; };
+            for (size_t i = 0; i < runs.size(); ++i) {
+                if (runs[i].next(heads[i])) {
+                    heap.push_back(i);
+                }
+            }
+            std::make_heap(heap.begin(), heap.end(), greater);
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), greater);
+                size_t run = heap.back();
+                if (tail == &head || tail->value < heads[run]) {
+                    tail->right = create_node(heads[run]);
+                    tail = tail->right;
+                    ++count;
+                }
+                if (runs[run].next(heads[run])) {
+                    std::push_heap(heap.begin(), heap.end(), greater);
+                } else {
+                    heap.pop_back();
+                }
+            }
+            for (const RunReader& reader : runs) {
+                if (reader.failed()) {
+                    throw std::runtime_error("Set::load_merged: corrupted data");
+                }
+            }
+        } catch (...) {
+            destroy(head.right);
+            release_chunks(chunks);
+            chunks.swap(kept_chunks);
+            free_list = kept_free_list;
+            inline_used = kept_inline_used;
+            throw;
+        }
+        std::vector<Chunk> merged_chunks;
+        merged_chunks.swap(chunks);
+        chunks.swap(kept_chunks);
+        free_list = kept_free_list;
+        inline_used = kept_inline_used;
+        destroy();
+        chunks.swap(merged_chunks);
+        build_from_chain(head.right, count);
     }
 
-    size_t size() const { return node_count; }
-
-    bool empty() const { return node_count == 0; }
+    void load_merged(const std::vector<std::string>& paths) {
+        std::vector<std::ifstream> files;
+        std::vector<std::istream*> inputs;
+        files.reserve(paths.size());
+        for (const std::string& path : paths) {
+            files.emplace_back(path, std::ios::binary);
+            inputs.push_back(&files.back());
+        }
+        load_merged(inputs);
+    }
 
-    ~Set() { destroy(root); }
+    ~Set() { destroy(); }
 
   private:
     // Auxiliary class for storing node's information.
-    struct Node {
+    using KeyPrefix = SetKeyPrefix<T>;
+    using Probe = typename KeyPrefix::Probe;
+
+    struct Node : KeyPrefix::Inline {
         static constexpr int32_t UNDEFINED = -1;
         static constexpr int32_t LEFT = 0;
         static constexpr int32_t RIGHT = -1;
         Node* parent = nullptr;
         Node* left = nullptr;
         Node* right = nullptr;
-        int32_t height = UNDEFINED;
+        // Balance information, kept by Balance policy. It is small, so it shares a word with the flag.
+        int16_t height = UNDEFINED;
+        // Set by lazy erase: node stays in the tree, but lookups and iterators skip it.
+        bool deleted = false;
         T value;
 
         Node() = default;
@@ -134,8 +1319,219 @@ class Set {
             left = other->left;
             right = other->right;
             height = other->height;
-            value = other->value;
+            deleted = other->deleted;
+            static_cast<typename KeyPrefix::Inline&>(*this) = *other;
+            value = std::move(other->value);
+        }
+    };
+
+    // Contiguous block of node slots. Nodes are carved out of chunks instead of being allocated one by one.
+    struct Chunk {
+        Node* nodes;
+        size_t capacity;
+        size_t used;
+    };
+
+    // Header of binary format, written by save().
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key_size;
+        uint64_t count;
+    };
+
+    // Default serializer, copying bytes of trivially copyable keys.
+    struct RawSerializer {
+        void operator()(std::ostream& out, const T& val) const {
+            static_assert(std::is_trivially_copyable<T>::value, "Set: custom serializer is needed");
+            out.write(reinterpret_cast<const char*>(&val), sizeof(T));
+        }
+
+        T operator()(std::istream& in) const {
+            static_assert(std::is_trivially_copyable<T>::value, "Set: custom serializer is needed");
+            T val;
+            in.read(reinterpret_cast<char*>(&val), sizeof(T));
+            return val;
+        }
+    };
+
+    // Buffered reader of sorted run, written by save() with raw serializer.
+    class RunReader {
+      public:
+        explicit RunReader(std::istream& in_) : in(&in_), remaining(read_header(in_, sizeof(T))) {
+            static_assert(std::is_trivially_copyable<T>::value, "Set: custom serializer is needed");
+        }
+
+        // Reads next key of the run. Returns false, when run is over or broken.
+        bool next(T& val) {
+            if (remaining == 0 || broken) {
+                return false;
+            }
+            if (pos == buffer.size()) {
+                size_t keys = BUFFER_KEYS;
+                if (remaining < keys) {
+                    keys = static_cast<size_t>(remaining);
+                }
+                buffer.resize(keys * sizeof(T));
+                in->read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                pos = 0;
+                if (!*in) {
+                    broken = true;
+                    return false;
+                }
+            }
+            T cur;
+            std::memcpy(&cur, buffer.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            --remaining;
+            if (started && cur < last) {
+                broken = true;
+                return false;
+            }
+            started = true;
+            last = cur;
+            val = cur;
+            return true;
+        }
+
+        bool failed() const { return broken; }
+
+      private:
+        static constexpr size_t BUFFER_KEYS = (1 << 20) / sizeof(T) + 1;
+        std::istream* in;
+        uint64_t remaining;
+        std::vector<char> buffer;
+        size_t pos = 0;
+        bool started = false;
+        bool broken = false;
+        T last;
+    };
+
+    /*
+     * Entries of lookup cache. Each cached node is kept in the entry of its current key,
+     * so entry is found and cleared, whenever node is freed, moved or changes key.
+     */
+    struct LookupCache {
+        LookupCache(size_t entries, uint64_t (*hash_)(const T&)) : hash(hash_) {
+            while ((size_t(1) << bits) < entries) {
+                ++bits;
+            }
+            nodes.assign(size_t(1) << bits, nullptr);
+        }
+
+        Node** slot(const T& val) {
+            // Fibonacci hashing spreads keys with weak hash, like integers with identity one.
+            uint64_t mixed = hash(val) * 0x9E3779B97F4A7C15ull;
+            return &nodes[bits == 0 ? 0 : mixed >> (64 - bits)];
+        }
+
+        void invalidate(Node* node) {
+            Node** entry = slot(node->value);
+            if (*entry == node) {
+                *entry = nullptr;
+            }
+        }
+
+        uint64_t (*hash)(const T&);
+        unsigned bits = 0;
+        std::vector<Node*> nodes;
+        LookupCacheStats stats{0, 0};
+    };
+
+    // Bloom filter of the keys, split into blocks of one cache line.
+    struct BloomFilter {
+        BloomFilter(size_t bits_per_key_, uint64_t (*hash_)(const T&)) : hash(hash_), bits_per_key(bits_per_key_) {
+            // About ln(2) * bits_per_key hashes is optimal, 9-bit slices of 64-bit hash give at most 7.
+            hashes = bits_per_key * 69 / 100;
+            hashes = hashes < 1 ? 1 : (hashes > MAX_HASHES ? MAX_HASHES : hashes);
+        }
+
+        void reset(size_t keys) {
+            capacity = keys;
+            stale = 0;
+            blocks = (keys * bits_per_key + BLOCK_BITS - 1) / BLOCK_BITS;
+            // Vector aligns words only by 8 bytes, so blocks start from the first cache line boundary in it.
+            storage.assign(blocks * BLOCK_WORDS + BLOCK_WORDS - 1, 0);
+            uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+            words = storage.data() + (BLOCK_BITS / 8 - address % (BLOCK_BITS / 8)) % (BLOCK_BITS / 8) / sizeof(uint64_t);
         }
+
+        void add(const T& val) {
+            uint64_t* block;
+            uint64_t bits;
+            locate(val, block, bits);
+            for (size_t i = 0; i < hashes; ++i, bits >>= SLICE) {
+                size_t bit = bits & (BLOCK_BITS - 1);
+                block[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+        }
+
+        bool may_contain(const T& val) {
+            uint64_t* block;
+            uint64_t bits;
+            locate(val, block, bits);
+            for (size_t i = 0; i < hashes; ++i, bits >>= SLICE) {
+                size_t bit = bits & (BLOCK_BITS - 1);
+                if (!(block[bit / 64] >> (bit % 64) & 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Block is chosen by high half of mixed hash, bits inside it by slices of remixed one.
+        void locate(const T& val, uint64_t*& block, uint64_t& bits) {
+            uint64_t mixed = hash(val) * 0x9E3779B97F4A7C15ull;
+            block = words + ((mixed >> 32) * blocks >> 32) * BLOCK_WORDS;
+            bits = (mixed ^ mixed >> 29) * 0xBF58476D1CE4E5B9ull;
+        }
+
+        static constexpr size_t BLOCK_BITS = 512;
+        static constexpr size_t BLOCK_WORDS = BLOCK_BITS / 64;
+        static constexpr size_t SLICE = 9;
+        static constexpr size_t MAX_HASHES = 7;
+        uint64_t (*hash)(const T&);
+        size_t bits_per_key;
+        size_t hashes;
+        std::vector<uint64_t> storage;
+        // Blocks inside storage, aligned to cache line.
+        uint64_t* words = nullptr;
+        uint64_t blocks = 0;
+        // Number of keys, filter is sized for, and number of erased keys, whose bits are still set.
+        size_t capacity = 0;
+        size_t stale = 0;
+        uint64_t rejected = 0;
+        uint64_t false_positives = 0;
+    };
+
+    // Buffered insert or erase of key.
+    struct Write {
+        T key;
+        bool insert;
+    };
+
+    // Released node slot, linked into the free list until it is reused.
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    // State of optional features. It is allocated, once any of them is turned on, so that plain set stays small.
+    struct Extras {
+        // Compaction state: chunks starting from compact_from receive relocated nodes,
+        // compact_cursor is the key of the next node to relocate.
+        bool compacting = false;
+        size_t compact_from = 0;
+        T compact_cursor;
+        std::unique_ptr<LookupCache> cache;
+        std::unique_ptr<BloomFilter> filter;
+        // Buffered writes and size of buffer, which triggers flush. Buffering is off for 0.
+        std::vector<Write> write_buffer;
+        size_t write_limit = 0;
+        // Lazy erase: nodes, marked as deleted, and their share of the tree, which triggers rebuild. Off for 0.
+        size_t deleted_count = 0;
+        double deleted_ratio = 0;
+        // Thread for background teardown, null while it is off.
+        std::shared_ptr<SetReaper> reaper;
     };
 
   public:
@@ -163,7 +1559,9 @@ class Set {
         T* operator->() const { return &node->value; }
 
         iterator& operator++() {
-            node = get_next_vertex(node);
+            do {
+                node = get_next_vertex(node);
+            } while (node != nullptr && node->deleted);
             return *this;
         }
 
@@ -174,7 +1572,9 @@ class Set {
         }
 
         iterator& operator--() {
-            node = get_prev_vertex(node);
+            do {
+                node = get_prev_vertex(node);
+            } while (node != nullptr && node->deleted);
             return *this;
         }
 
@@ -234,157 +1634,609 @@ class Set {
         }
 
         Node* node = nullptr;
+
+        friend class Set;
     };
 
   private:
-    Node* get_leftest_node(Node* node) {
+    Extras& extra() {
+        if (!extras) {
+            extras.reset(new Extras());
+        }
+        return *extras;
+    }
+
+    LookupCache* lookup_cache() const { return extras ? extras->cache.get() : nullptr; }
+
+    BloomFilter* bloom_filter() const { return extras ? extras->filter.get() : nullptr; }
+
+    bool compacting() const { return extras && extras->compacting; }
+
+    size_t deleted_count() const { return extras ? extras->deleted_count : 0; }
+
+    static Node* get_leftest_node(Node* node) {
         while (node->left != nullptr) {
             node = node->left;
         }
         return node;
     }
 
-    int32_t get_height(Node* node) { return node == nullptr ? Node::UNDEFINED : node->height; }
-
-    int32_t height_difference(Node* node) {
-        return node ? get_height(node->left) - get_height(node->right) : 0;
+    // Returns root itself for empty tree.
+    Node* get_rightest_node(Node* node) const {
+        if (node == root) {
+            node = root->left;
+            if (node == nullptr) {
+                return root;
+            }
+        }
+        while (node->right != nullptr) {
+            node = node->right;
+        }
+        return node;
     }
 
-    // Auxiliary function for deleting tree and releasing memory.
-    void destroy(Node* node) {
-        if (node == nullptr) {
-            return;
+    // Returns root, if node is the minimum.
+    Node* get_prev_node(Node* node) const {
+        if (node->left != nullptr) {
+            return get_rightest_node(node->left);
         }
-        destroy(node->left);
-        destroy(node->right);
-        delete node;
+        while (node != root && node->parent->left == node) {
+            node = node->parent;
+        }
+        return node == root ? root : node->parent;
     }
 
-    void destroy() { destroy(root->left); }
+    static bool probe_less(const Probe& probe, Node* node) { return KeyPrefix::less(probe, *node, node->value); }
 
-    void update_height(Node* node) {
-        node->height = 1 + std::max(get_height(node->left), get_height(node->right));
+    static bool node_less(Node* node, const Probe& probe) { return KeyPrefix::greater(probe, *node, node->value); }
+
+    // Lower bound of probe in subtree of cur. If it doesn't exist there, returns ans.
+    static Node* descend(Node* cur, Node* ans, const Probe& probe) {
+        while (cur) {
+            if (node_less(cur, probe)) {
+                cur = cur->right;
+            } else {
+                ans = cur;
+                cur = cur->left;
+            }
+        }
+        return ans;
+    }
+
+    // Returns the lowest node, for which before(key) is false, or root. Keys, for which it is true, go first.
+    template<typename Before>
+    Node* partition_point(Before before) const {
+        sync();
+        Node* cur = root->left;
+        Node* ans = root;
+        while (cur) {
+            if (before(cur->value)) {
+                cur = cur->right;
+            } else {
+                ans = cur;
+                cur = cur->left;
+            }
+        }
+        return skip_deleted(ans);
     }
 
-    Node* left_rotate(Node* node) {
-        Node* temp = node->right;
-        node->right = temp->left;
-        if (temp->left) {
-            temp->left->parent = node;
+    Node* finger_lower_bound(Node* hint, const Probe& probe) const {
+        if (hint == root || !node_less(hint, probe)) {
+            // Answer is hint or lies before it.
+            Node* prev = hint == root ? rightmost : get_prev_node(hint);
+            if (prev == root || node_less(prev, probe)) {
+                return hint;
+            }
+            // Climb until subtree surely contains answer: its lower boundary is less than val.
+            Node* cur = prev;
+            while (cur->parent != root && !(cur->parent->right == cur && node_less(cur->parent, probe))) {
+                cur = cur->parent;
+            }
+            return descend(cur, root, probe);
         }
-        temp->left = node;
-        temp->parent = node->parent;
-        node->parent = temp;
-        update_height(node);
-        update_height(temp);
-        return temp;
+        if (hint == rightmost) {
+            return root;
+        }
+        // Climb until upper boundary of subtree is not less than val.
+        Node* cur = hint;
+        while (cur->parent != root && !(cur->parent->left == cur && !node_less(cur->parent, probe))) {
+            cur = cur->parent;
+        }
+        return descend(cur, cur->parent, probe);
     }
 
-    Node* right_rotate(Node* node) {
-        Node* temp = node->left;
-        node->left = temp->right;
-        if (temp->right) {
-            temp->right->parent = node;
+    // Inserts val right before next, which must become its successor.
+    Node* attach_before(Node* next, const T& val) {
+        if (root->left == nullptr) {
+            return attach(root, true, val);
         }
-        temp->right = node;
-        temp->parent = node->parent;
-        node->parent = temp;
-        update_height(node);
-        update_height(temp);
-        return temp;
+        if (next == root) {
+            return attach(rightmost, false, val);
+        }
+        if (next->left == nullptr) {
+            return attach(next, true, val);
+        }
+        return attach(get_rightest_node(next->left), false, val);
     }
 
-    Node* big_left_rotate(Node* node) {
-        node->right = right_rotate(node->right);
-        return left_rotate(node);
+    // Applies pending buffered writes before read. Content doesn't change, but the tree does, see set_write_buffer().
+    void sync() const {
+        if (extras && !extras->write_buffer.empty()) {
+            const_cast<Set*>(this)->flush();
+        }
     }
 
-    Node* big_right_rotate(Node* node) {
-        node->left = left_rotate(node->left);
-        return right_rotate(node);
+    void buffer_write(const T& val, bool insert) {
+        extras->write_buffer.push_back(Write{val, insert});
+        if (extras->write_buffer.size() >= extras->write_limit) {
+            flush();
+        }
     }
 
-    // Standard AVL's rotate implementation.
-    Node* rotate(Node* node) {
-        int32_t n_diff = height_difference(node);
-        int32_t l_diff = height_difference(node->left);
-        int32_t r_diff = height_difference(node->right);
-        if (n_diff == -TWO) {
-            if (r_diff == ONE) {
-                node = big_left_rotate(node);
+    /*
+     * Merges sorted writes with distinct keys into the tree, dropping deleted nodes. Visited nodes are chained
+     * by left pointers, which next steps of in-order walk don't read, and dropped ones are freed after the walk.
+     */
+    void merge_writes(const std::vector<Write>& writes) {
+        Node head;
+        Node* tail = &head;
+        Node* erased = nullptr;
+        size_t count = 0;
+        auto keep = [&](Node* node) {
+            if (node->deleted) {
+                node->left = erased;
+                erased = node;
             } else {
-                node = left_rotate(node);
+                tail = tail->left = node;
+                ++count;
             }
-        } else if (n_diff == TWO) {
-            if (l_diff == -ONE) {
-                node = big_right_rotate(node);
-            } else {
-                node = right_rotate(node);
+        };
+        Node* cur = get_leftest_node(root);
+        for (const Write& write : writes) {
+            while (cur != root && cur->value < write.key) {
+                Node* next = get_next_node(cur);
+                keep(cur);
+                cur = next;
+            }
+            if (cur != root && !(write.key < cur->value)) {
+                Node* next = get_next_node(cur);
+                cur->deleted = !write.insert;
+                keep(cur);
+                cur = next;
+            } else if (write.insert) {
+                tail = tail->left = create_node(write.key);
+                ++count;
+            }
+        }
+        while (cur != root) {
+            Node* next = get_next_node(cur);
+            keep(cur);
+            cur = next;
+        }
+        tail->left = nullptr;
+        for (Node* node = head.left; node != nullptr; node = node->left) {
+            node->right = node->left;
+        }
+        while (erased != nullptr) {
+            Node* next = erased->left;
+            release_node(erased);
+            erased = next;
+        }
+        build_from_chain(head.left, count);
+    }
+
+    // Unlinks node from tree and frees it. Does nothing for root. Returns node, which holds the next key now.
+    Node* erase_node(Node* node) {
+        if (node == root) {
+            return root;
+        }
+        Node* result = node;
+        // Node with two children takes key of the next one, which is unlinked instead.
+        if (node->left && node->right) {
+            Node* next = get_leftest_node(node->right);
+            if (LookupCache* cache = lookup_cache()) {
+                // Entry of the moved key follows it, as moved-from key of next can't find the entry later.
+                cache->invalidate(node);
+                Node** entry = cache->slot(next->value);
+                if (*entry == next) {
+                    *entry = node;
+                }
             }
+            node->value = std::move(next->value);
+            node->deleted = next->deleted;
+            static_cast<typename KeyPrefix::Inline&>(*node) = *next;
+            node = next;
+        } else {
+            result = get_next_node(node);
+        }
+        Node* child = node->left ? node->left : node->right;
+        Node* parent = node->parent;
+        bool is_left = parent->left == node;
+        if (is_left) {
+            parent->left = child;
+        } else {
+            parent->right = child;
+        }
+        if (child) {
+            child->parent = parent;
+        }
+        Balance::after_erase(parent, child, is_left, node->height, root);
+        release_node(node);
+        --node_count;
+        BloomFilter* filter = bloom_filter();
+        if (filter && ++filter->stale > filter->capacity / 8) {
+            rebuild_filter();
+        }
+        if (rightmost == nullptr) {
+            rightmost = get_rightest_node(root);
+        }
+        return result;
+    }
+
+    // Lazy erase: node stays linked until the tree is rebuilt. Does nothing for root or deleted node.
+    void mark_deleted(Node* node) {
+        if (node == root || node->deleted) {
+            return;
+        }
+        if (LookupCache* cache = lookup_cache()) {
+            cache->invalidate(node);
+        }
+        node->deleted = true;
+        --node_count;
+        size_t deleted = ++extras->deleted_count;
+        BloomFilter* filter = bloom_filter();
+        if (filter && ++filter->stale > filter->capacity / 8) {
+            rebuild_filter();
+        }
+        if (deleted > extras->deleted_ratio * double(node_count + deleted)) {
+            purge_deleted();
+        }
+    }
+
+    void revive(Node* node) {
+        if (!node->deleted) {
+            return;
+        }
+        node->deleted = false;
+        ++node_count;
+        --extras->deleted_count;
+        if (BloomFilter* filter = bloom_filter()) {
+            filter->add(node->value);
+        }
+    }
+
+    // Rebuilds tree from its live nodes in O(tree_size).
+    void purge_deleted() { merge_writes(std::vector<Write>()); }
+
+    // Returns the first live node, starting from node, or root.
+    static Node* skip_deleted(Node* node) {
+        while (node->deleted) {
+            node = get_next_node(node);
         }
         return node;
     }
 
-    // Auxiliary function for erasing element from tree.
-    Node* recursive_erase(Node* node, const T& val) {
-        if (node == nullptr) {
-            return node;
+    // Links new node as a child of parent and restores balance bottom-up.
+    Node* attach(Node* parent, bool is_left, const T& val) {
+        Node* node = create_node(val);
+        ++node_count;
+        node->parent = parent;
+        if (is_left) {
+            parent->left = node;
+        } else {
+            parent->right = node;
+        }
+        if (parent == root || (parent == rightmost && !is_left)) {
+            rightmost = node;
         }
-        if (val < node->value) {
-            node->left = recursive_erase(node->left, val);
-            if (node->left) {
-                node->left->parent = node;
+        Balance::after_insert(node, root);
+        if (BloomFilter* filter = bloom_filter()) {
+            filter->add(val);
+            if (node_count > filter->capacity) {
+                rebuild_filter();
             }
-        } else if (node->value < val) {
-            node->right = recursive_erase(node->right, val);
-            if (node->right) {
-                node->right->parent = node;
+        }
+        return node;
+    }
+
+    // Resizes filter with room for twice as many keys, as there are now, and refills it from the tree.
+    void rebuild_filter() {
+        BloomFilter* filter = bloom_filter();
+        filter->reset(node_count * TWO > MIN_FILTER_KEYS ? node_count * TWO : MIN_FILTER_KEYS);
+        for (Node* cur = get_leftest_node(root); cur != root; cur = get_next_node(cur)) {
+            if (!cur->deleted) {
+                filter->add(cur->value);
             }
-        } else {
-            if (node->left && node->right) {
-                Node* temp = get_leftest_node(node->right);
-                node->value = temp->value;
-                node->right = recursive_erase(node->right, temp->value);
-                if (node->right) {
-                    node->right->parent = node;
-                }
+        }
+    }
+
+    static Node* get_next_node(Node* node) {
+        if (node->right != nullptr) {
+            return get_leftest_node(node->right);
+        }
+        while (node->parent->right == node) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+
+    // Auxiliary function for deleting tree. Memory is released together with chunks.
+    // Left children are rotated into right spine, so that depth of tree doesn't matter.
+    static void destroy(Node* node) {
+        if (std::is_trivially_destructible<Node>::value) {
+            return;
+        }
+        while (node != nullptr) {
+            if (node->left != nullptr) {
+                Node* left = node->left;
+                node->left = left->right;
+                left->right = node;
+                node = left;
             } else {
-                Node* temp = node->left ? node->left : node->right;
-                delete node;
-                --node_count;
-                node = temp;
-                if (node) {
-                    node->parent = nullptr;
-                }
+                Node* next = node->right;
+                node->~Node();
+                node = next;
             }
         }
-        if (node == nullptr) {
-            return node;
+    }
+
+    void destroy() {
+        SetReaper* reaper = nullptr;
+        if (extras) {
+            extras->write_buffer.clear();
+            if (extras->cache) {
+                std::fill(extras->cache->nodes.begin(), extras->cache->nodes.end(), nullptr);
+            }
+            if (extras->filter) {
+                extras->filter->reset(MIN_FILTER_KEYS);
+            }
+            extras->deleted_count = 0;
+            reaper = extras->reaper.get();
         }
-        node = rotate(node);
-        update_height(node);
-        return node;
+        Node* tree = root->left;
+        root->left = nullptr;
+        rightmost = root;
+        node_count = 0;
+        if (reaper && !chunks.empty() && (std::is_trivially_destructible<Node>::value || inline_used == 0)) {
+            std::vector<Chunk> detached;
+            detached.swap(chunks);
+            release_chunks();
+            try {
+                reaper->post([tree, detached]() mutable {
+                    destroy(tree);
+                    release_chunks(detached);
+                });
+                return;
+            } catch (const std::bad_alloc&) {
+                chunks.swap(detached);
+            }
+        }
+        destroy(tree);
+        release_chunks();
     }
 
-    // Auxiliary function for inserting element from tree.
-    Node* recursive_insert(Node* node, const T& val) {
-        if (node == nullptr) {
-            node = new Node(val);
-            ++node_count;
-        } else if (val < node->value) {
-            node->left = recursive_insert(node->left, val);
+    // Reads and validates header, written by save(). Returns element count.
+    static uint64_t read_header(std::istream& in, uint64_t key_size) {
+        Header header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || header.magic != MAGIC || header.version != VERSION || header.key_size != key_size) {
+            throw std::runtime_error("Set::load: unsupported format");
+        }
+        return header.count;
+    }
+
+    // Bytes left in the stream, or maximum for streams, which can't seek.
+    static uint64_t remaining_bytes(std::istream& in) {
+        std::istream::pos_type pos = in.tellg();
+        if (pos == std::istream::pos_type(-1)) {
+            in.clear();
+            return std::numeric_limits<uint64_t>::max();
+        }
+        in.seekg(0, std::ios::end);
+        std::istream::pos_type end = in.tellg();
+        in.clear();
+        in.seekg(pos);
+        if (end == std::istream::pos_type(-1) || end < pos) {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return static_cast<uint64_t>(end - pos);
+    }
+
+    // Key size is stored in header only for raw format, so that sets of different types aren't mixed up.
+    static uint64_t key_size(const RawSerializer&) { return sizeof(T); }
+
+    template<typename Serializer>
+    static uint64_t key_size(const Serializer&) {
+        return 0;
+    }
+
+    // Builds perfectly balanced tree from n nodes, linked in ascending order by right pointers.
+    // Its last level is floor(log2(n)) of the whole tree, all other levels are full.
+    Node* build_balanced(Node*& head, size_t n, int32_t depth, int32_t last_level) {
+        if (n == 0) {
+            return nullptr;
+        }
+        Node* left = build_balanced(head, n / TWO, depth + ONE, last_level);
+        Node* node = head;
+        head = head->right;
+        node->left = left;
+        node->right = build_balanced(head, n - n / TWO - ONE, depth + ONE, last_level);
+        if (node->left) {
             node->left->parent = node;
-        } else if (node->value < val) {
-            node->right = recursive_insert(node->right, val);
+        }
+        if (node->right) {
             node->right->parent = node;
         }
-        node = rotate(node);
-        update_height(node);
+        Balance::built(node, depth, last_level);
+        return node;
+    }
+
+    // Makes chain of n nodes, linked in ascending order by right pointers, content of the empty set.
+    void build_from_chain(Node* head, size_t n) {
+        if (head != nullptr) {
+            Node* tail = head;
+            while (tail->right != nullptr) {
+                tail = tail->right;
+            }
+            key_prefix.reset(head->value, tail->value);
+            for (Node* cur = head; cur != nullptr; cur = cur->right) {
+                key_prefix.assign(*cur, cur->value);
+            }
+        }
+        int32_t last_level = 0;
+        while (n >> (last_level + ONE) != 0) {
+            ++last_level;
+        }
+        root->left = build_balanced(head, n, 0, last_level);
+        if (root->left) {
+            root->left->parent = root;
+        }
+        rightmost = get_rightest_node(root);
+        node_count = n;
+        if (extras) {
+            extras->deleted_count = 0;
+            if (extras->filter) {
+                rebuild_filter();
+            }
+        }
+    }
+
+    void discard_chain(Node* head) {
+        while (head != nullptr) {
+            Node* next = head->right;
+            release_node(head);
+            head = next;
+        }
+    }
+
+    void add_chunk(size_t capacity) {
+        chunks.push_back({std::allocator<Node>().allocate(capacity), capacity, 0});
+    }
+
+    static void release_chunks(std::vector<Chunk>& chunks) {
+        for (Chunk& chunk : chunks) {
+            std::allocator<Node>().deallocate(chunk.nodes, chunk.capacity);
+        }
+        chunks.clear();
+    }
+
+    void release_chunks() {
+        release_chunks(chunks);
+        inline_used = 0;
+        free_list = nullptr;
+        if (extras) {
+            extras->compact_from = 0;
+            extras->compacting = false;
+        }
+    }
+
+    // Takes slot from free list, inline storage, or the last chunk. Chunk sizes grow geometrically.
+    // Compaction moves nodes out of inline storage, so it isn't used until compaction is finished.
+    void* allocate_slot() {
+        if (free_list != nullptr) {
+            FreeSlot* slot = free_list;
+            free_list = slot->next;
+            return slot;
+        }
+        if (inline_used < InlineCapacity && !compacting()) {
+            return inline_nodes.nodes() + inline_used++;
+        }
+        if (chunks.empty() || chunks.back().used == chunks.back().capacity) {
+            size_t capacity = chunks.empty() ? MIN_CHUNK : chunks.back().capacity * TWO;
+            add_chunk(capacity < MAX_CHUNK ? capacity : MAX_CHUNK);
+        }
+        Chunk& chunk = chunks.back();
+        return chunk.nodes + chunk.used++;
+    }
+
+    Node* create_node(const T& val) {
+        Node* node = new (allocate_slot()) Node(val);
+        key_prefix.assign(*node, node->value);
         return node;
     }
 
+    // Lets key prefix know about new key, recomputing cached data of nodes, if needed.
+    // Deleted nodes keep their cached data too, so only tree without any nodes counts as empty.
+    void admit(const T& val) {
+        if (key_prefix.admit(val, root->left == nullptr)) {
+            for (Node* cur = get_leftest_node(root); cur != root; cur = get_next_node(cur)) {
+                key_prefix.assign(*cur, cur->value);
+            }
+        }
+    }
+
+    void release_node(Node* node) {
+        if (node == rightmost) {
+            rightmost = nullptr;
+        }
+        if (LookupCache* cache = lookup_cache()) {
+            cache->invalidate(node);
+        }
+        node->~Node();
+        // During compaction slots of the old chunks are abandoned, not reused.
+        if (!compacting() || is_compacted(node)) {
+            free_list = new (static_cast<void*>(node)) FreeSlot{free_list};
+        }
+    }
+
+    // Checks, whether node lies in chunks, allocated by ongoing compaction.
+    bool is_compacted(Node* node) const {
+        std::less<Node*> less;
+        for (size_t i = extras->compact_from; i < chunks.size(); ++i) {
+            if (!less(node, chunks[i].nodes) && less(node, chunks[i].nodes + chunks[i].capacity)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves node to a fresh slot and remaps pointers of its parent and children.
+    void relocate(Node* node) {
+        LookupCache* cache = lookup_cache();
+        Node** entry = cache ? cache->slot(node->value) : nullptr;
+        Node* moved = new (allocate_slot()) Node(node);
+        if (entry && *entry == node) {
+            *entry = moved;
+        }
+        if (moved->parent->left == node) {
+            moved->parent->left = moved;
+        } else {
+            moved->parent->right = moved;
+        }
+        if (moved->left) {
+            moved->left->parent = moved;
+        }
+        if (moved->right) {
+            moved->right->parent = moved;
+        }
+        if (node == rightmost) {
+            rightmost = moved;
+        }
+        node->~Node();
+    }
+
     size_t node_count = 0;
-    Node* root;
+    // Invariant of root!=null is needed for always having node, representing end() iterator.
+    // It lives inside Set object, so that empty set makes no allocations.
+    Node sentinel;
+    Node* root = &sentinel;
+    // Maximum node, or root for empty tree. Makes appending with hint O(1).
+    Node* rightmost = root;
+    std::vector<Chunk> chunks;
+    FreeSlot* free_list = nullptr;
+    std::unique_ptr<Extras> extras;
+    uint32_t inline_used = 0;
+    KeyPrefix key_prefix;
+    SetInlineNodes<Node, InlineCapacity> inline_nodes;
     static constexpr int32_t ONE = 1;
     static constexpr int32_t TWO = 2;
+    static constexpr size_t MIN_CHUNK = 16;
+    static constexpr size_t MAX_CHUNK = 1 << 16;
+    static constexpr size_t MIN_FILTER_KEYS = 64;
+    // Keys, reserved by load() ahead of reading, if stream size is unknown.
+    static constexpr uint64_t MAX_RESERVE = 1 << 16;
+    // Batches of at least tree_size / BULK_FACTOR writes are merged with the tree.
+    static constexpr size_t BULK_FACTOR = 16;
+    static constexpr uint32_t MAGIC = 0x534c5641;  // "AVLS"
+    static constexpr uint32_t VERSION = 1;
 };
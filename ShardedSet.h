@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ConcurrentSet.h"
+#include "Set.h"
+
+/*
+ * Set for concurrent writers, range-partitioned into Shards independent Sets, each with its own lock
+ * and node pool. Shard i holds keys in [splitters[i - 1], splitters[i]), so updates of different ranges
+ * don't contend, and shards together keep global order.
+ * When a shard grows beyond twice the average, all shards are re-split at quantiles of the keys,
+ * with other operations waiting for it. Splitters are cheaper to keep than concurrent tree,
+ * but skewed inserts pay amortized O(Shards) moves per key for re-splitting.
+ * Splitters are immutable and published by pointer, which re-split replaces under locks of all shards.
+ * Operation reads them without lock, locks its shard and checks that they are still published,
+ * so besides its shard it touches only shared read-mostly data and its own epoch slot.
+ * Template type must have operator < and be copyable.
+ * It supports following operations in O(log(tree_size)), safe to call from different threads:
+ * - insert
+ * - erase
+ * - contains
+ * - lower_bound, which crosses into the next shards, if needed
+ * Iteration goes over all shards in order, but must not run concurrently with updates.
+ */
+template<class T, size_t Shards = 16>
+class ShardedSet {
+    static_assert(Shards > 0, "ShardedSet: there must be at least one shard");
+
+  public:
+    ShardedSet() : published(new Layout()) {}
+
+    ShardedSet(const ShardedSet&) = delete;
+
+    ShardedSet& operator=(const ShardedSet&) = delete;
+
+    ShardedSet(const std::initializer_list<T>& elems) : ShardedSet() {
+        for (const T& val : elems) {
+            insert(val);
+        }
+    }
+
+    ~ShardedSet() { delete published.load(); }
+
+    class iterator;
+
+    bool contains(const T& val) const {
+        Guard guard(epochs);
+        std::unique_lock<std::mutex> lock;
+        const Shard& shard = shards[lock_shard(val, lock)];
+        return shard.keys.contains(val);
+    }
+
+    // Finds the lowest key >= val and writes it to result. Returns false, if there is no such key.
+    bool lower_bound(const T& val, T& result) const {
+        Guard guard(epochs);
+        while (true) {
+            const Layout* layout = published.load(std::memory_order_acquire);
+            size_t i = shard_index(*layout, val);
+            for (; i < Shards; ++i) {
+                const Shard& shard = shards[i];
+                std::lock_guard<std::mutex> lock(shard.lock);
+                if (published.load(std::memory_order_acquire) != layout) {
+                    break;
+                }
+                typename Set<T>::iterator it = shard.keys.lower_bound(val);
+                if (it != shard.keys.end()) {
+                    result = *it;
+                    return true;
+                }
+            }
+            if (i == Shards) {
+                return false;
+            }
+        }
+    }
+
+    // Inserts element in its shard. If such exists, does nothing. May re-split shards afterwards.
+    void insert(const T& val) {
+        bool overflow;
+        {
+            Guard guard(epochs);
+            std::unique_lock<std::mutex> lock;
+            Shard& shard = shards[lock_shard(val, lock)];
+            shard.keys.insert(val);
+            size_t count = shard.keys.size();
+            shard.count.store(count, std::memory_order_relaxed);
+            overflow = count > shard_limit.load(std::memory_order_relaxed);
+        }
+        if (overflow) {
+            resplit(true);
+        }
+    }
+
+    // Erases element from its shard. If such doesn't exist, does nothing.
+    void erase(const T& val) {
+        Guard guard(epochs);
+        std::unique_lock<std::mutex> lock;
+        Shard& shard = shards[lock_shard(val, lock)];
+        shard.keys.erase(val);
+        shard.count.store(shard.keys.size(), std::memory_order_relaxed);
+    }
+
+    // Moves keys between shards, so that each gets the same share of them, in O(size).
+    void resplit() { resplit(false); }
+
+    /*
+     * Sum of shard sizes. Counts are atomics, stored under shard locks, so size() takes no lock
+     * and reads each of them whole, but under concurrent updates the sum is not a snapshot of one moment.
+     */
+    size_t size() const {
+        size_t count = 0;
+        for (const Shard& shard : shards) {
+            count += shard.count.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Sizes of shards in order of their ranges.
+    std::vector<size_t> shard_sizes() const {
+        std::vector<size_t> sizes;
+        for (const Shard& shard : shards) {
+            sizes.push_back(shard.count.load(std::memory_order_relaxed));
+        }
+        return sizes;
+    }
+
+    iterator begin() const { return iterator(this, 0, shards[0].keys.begin()).skip_empty(); }
+
+    iterator end() const { return iterator(this, Shards - 1, shards[Shards - 1].keys.end()); }
+
+    /*
+     * Bidirectional iterator over keys of all shards in ascending order
+     * Doesn't support random access
+     * Prefix/postfix increment/decrement works in amortized O(1), plus O(Shards) for skipped empty shards
+     * */
+    class iterator {
+      public:
+        iterator() = default;
+
+        bool operator==(const iterator& it) const { return it.index == index && it.cur == cur; }
+
+        bool operator!=(const iterator& it) const { return !(*this == it); }
+
+        T operator*() const { return *cur; }
+
+        const T* operator->() const { return cur.operator->(); }
+
+        iterator& operator++() {
+            ++cur;
+            return skip_empty();
+        }
+
+        iterator operator++(int) {
+            iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        iterator& operator--() {
+            while (index > 0 && cur == set->shards[index].keys.begin()) {
+                --index;
+                cur = set->shards[index].keys.end();
+            }
+            --cur;
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+
+      private:
+        iterator(const ShardedSet* set_, size_t index_, typename Set<T>::iterator cur_)
+            : set(set_), index(index_), cur(cur_) {}
+
+        // Moves from the end of shard to the beginning of the next non-empty one.
+        iterator& skip_empty() {
+            while (index + 1 < Shards && cur == set->shards[index].keys.end()) {
+                ++index;
+                cur = set->shards[index].keys.begin();
+            }
+            return *this;
+        }
+
+        const ShardedSet* set = nullptr;
+        size_t index = 0;
+        typename Set<T>::iterator cur;
+
+        friend class ShardedSet;
+    };
+
+  private:
+    // Sorted lower bounds of shards 1, 2, ...; shards without splitter are empty. Never changed once published.
+    struct Layout {
+        std::vector<T> splitters;
+    };
+
+    using Guard = typename SetEpochs<Layout>::Guard;
+
+    // Shards are aligned to cache lines, so writers of neighbouring ones don't share them.
+    struct alignas(64) Shard {
+        mutable std::mutex lock;
+        Set<T> keys;
+        // Copy of keys.size(), readable without the lock.
+        std::atomic<size_t> count{0};
+    };
+
+    // Index of shard, whose range holds val.
+    static size_t shard_index(const Layout& layout, const T& val) {
+        return std::upper_bound(layout.splitters.begin(), layout.splitters.end(), val) - layout.splitters.begin();
+    }
+
+    // Locks shard, whose range holds val, and returns its index. Caller must hold Guard, so that
+    // the layout it reads isn't freed.
+    size_t lock_shard(const T& val, std::unique_lock<std::mutex>& lock) const {
+        while (true) {
+            const Layout* layout = published.load(std::memory_order_acquire);
+            size_t index = shard_index(*layout, val);
+            lock = std::unique_lock<std::mutex>(shards[index].lock);
+            // Re-split publishes under all shard locks, so layout stays current, while this one is held.
+            if (published.load(std::memory_order_acquire) == layout) {
+                return index;
+            }
+            lock.unlock();
+        }
+    }
+
+    bool imbalanced() const {
+        for (const Shard& shard : shards) {
+            if (shard.count.load(std::memory_order_relaxed) > shard_limit.load(std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Locks all shards in order and re-splits them, unless only_if_imbalanced and balance is already fine.
+    void resplit(bool only_if_imbalanced) {
+        for (Shard& shard : shards) {
+            shard.lock.lock();
+        }
+        if (!only_if_imbalanced || imbalanced()) {
+            try {
+                resplit_locked();
+            } catch (...) {
+                unlock_all();
+                throw;
+            }
+        }
+        unlock_all();
+    }
+
+    void unlock_all() {
+        for (Shard& shard : shards) {
+            shard.lock.unlock();
+        }
+    }
+
+    // All shards must be locked, so no other operation runs.
+    void resplit_locked() {
+        std::unique_ptr<Layout> layout(new Layout());
+        std::vector<T> keys;
+        keys.reserve(size());
+        for (Shard& shard : shards) {
+            for (const T& val : shard.keys) {
+                keys.push_back(val);
+            }
+            shard.keys.clear();
+        }
+        // Shard i gets keys [i * n / Shards, (i + 1) * n / Shards), its first key being a splitter.
+        size_t n = keys.size();
+        for (size_t i = 0; i < Shards; ++i) {
+            size_t first = i * n / Shards;
+            size_t last = (i + 1) * n / Shards;
+            if (i > 0 && first < n) {
+                layout->splitters.push_back(keys[first]);
+            }
+            Set<T>& shard_keys = shards[i].keys;
+            for (size_t j = first; j < last; ++j) {
+                shard_keys.insert(shard_keys.end(), keys[j]);
+            }
+            shards[i].count.store(last - first, std::memory_order_relaxed);
+        }
+        size_t limit = 2 * (n / Shards);
+        shard_limit.store(limit > MIN_SHARD_LIMIT ? limit : size_t(MIN_SHARD_LIMIT), std::memory_order_relaxed);
+        // Operations, which read the old layout, fail their check after locking a shard and retry.
+        Guard guard(epochs);
+        guard.retire(published.exchange(layout.release(), std::memory_order_acq_rel));
+    }
+
+    // Shard may grow to this size before the first re-split.
+    static constexpr size_t MIN_SHARD_LIMIT = 4096;
+    Shard shards[Shards];
+    std::atomic<Layout*> published;
+    std::atomic<size_t> shard_limit{MIN_SHARD_LIMIT};
+    // Old layouts are freed, once no operation can still read them.
+    mutable SetEpochs<Layout> epochs;
+};
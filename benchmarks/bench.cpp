@@ -1,401 +1,21 @@
 #include "bits/stdc++.h"
+#include "../BucketSet.h"
+#include "../CombiningSet.h"
+#include "../ConcurrentSet.h"
+#include "../IntegerSet.h"
+#include "../IntervalSet.h"
+#include "../MappedSet.h"
+#include "../PersistentSet.h"
+#include "../RcuSet.h"
+#include "../RoaringSet.h"
+#include "../Set.h"
+#include "../ShardedSet.h"
 #define timeStamp() std::chrono::steady_clock::now()
 #define duration_micro(a) chrono::duration_cast<chrono::microseconds>(a).count()
 #define duration_milli(a) chrono::duration_cast<chrono::milliseconds>(a).count()
 #define duration_nano(a) chrono::duration_cast<chrono::nanoseconds>(a).count()
 using namespace std;
 
-/*
- * Template analogue of std::set, based on AVL tree.
- * Template type must have operator <.
- * It supports standard set operations in guaranteed O(log(tree_size)):
- * - insert
- * - erase
- * - find
- * - lower_bound
- */
-template<class T>
-class Set {
-public:
-
-    // Invariant of root!=null is needed for always having node, representing end() iterator.
-    Set() { root = new Node(); }
-
-    Set(const Set<T>& other) {
-        root = new Node();
-        for (const T& val : other) {
-            insert(val);
-        }
-    }
-
-    // Assignment operator
-    Set& operator=(const Set& other) {
-        if (&other == this) {
-            return *this;
-        }
-        destroy();
-        root->left = nullptr;
-        node_count = 0;
-        for (T val : other) {
-            insert(val);
-        }
-        return *this;
-    }
-
-    Set(const std::initializer_list<T>& elems) {
-        root = new Node();
-        for (const T& val : elems) {
-            insert(val);
-        }
-    }
-
-    template<typename Iterator>
-    Set(const Iterator first, const Iterator last) {
-        root = new Node();
-        for (Iterator it = first; it != last; ++it) {
-            insert(*it);
-        }
-    }
-
-    class iterator;
-
-    // If needed value exists, returns iterator on corresponding node, otherwise end().
-    iterator find(const T& val) const {
-        Node* cur = root->left;
-        while (cur != nullptr) {
-            if (val < cur->value) {
-                cur = cur->left;
-            } else if (cur->value < val) {
-                cur = cur->right;
-            } else {
-                return iterator(cur);
-            }
-        }
-        return end();
-    }
-
-    // Returns iterator on node with the lowest key >= val.
-    iterator lower_bound(const T& val) const {
-        Node* cur = root->left;
-        Node* ans = root;
-        while (cur) {
-            if (cur->value < val) {
-                cur = cur->right;
-            } else {
-                ans = cur;
-                cur = cur->left;
-            }
-        }
-        return iterator(ans);
-    }
-
-    iterator begin() const {
-        Node* ans = root;
-        while (ans->left) {
-            ans = ans->left;
-        }
-        return iterator(ans);
-    }
-
-    iterator end() const { return iterator(root); }
-
-    // Inserts element in tree. If such exists, does nothing.
-    void insert(const T& val) {
-        root->left = recursive_insert(root->left, val);
-        root->left->parent = root;
-    }
-
-    // Erases element from tree. If such doesn't exist, does nothing.
-    void erase(const T& val) {
-        root->left = recursive_erase(root->left, val);
-        if (root->left) root->left->parent = root;
-    }
-
-    size_t size() const { return node_count; }
-
-    bool empty() const { return node_count == 0; }
-
-    ~Set() { destroy(root); }
-
-private:
-    // Auxiliary class for storing node's information.
-    struct Node {
-        static constexpr int32_t UNDEFINED = -1;
-        static constexpr int32_t LEFT = 0;
-        static constexpr int32_t RIGHT = -1;
-        Node* parent = nullptr;
-        Node* left = nullptr;
-        Node* right = nullptr;
-        int32_t height = UNDEFINED;
-        T value;
-
-        Node() = default;
-
-        explicit Node(const T& val) {
-            value = val;
-            height = 0;
-        }
-
-        explicit Node(Node* other) {
-            parent = other->parent;
-            left = other->left;
-            right = other->right;
-            height = other->height;
-            value = other->value;
-        }
-    };
-
-public:
-    /*
-     * Bidirectional iterator for AVL tree nodes
-     * Doesn't support random access
-     * Prefix/postfix increment/decrement works in amortized O(1)
-     * */
-    class iterator {
-    public:
-        iterator() = default;
-
-        explicit iterator(Node* node_) { node = node_; }
-
-        bool operator==(const iterator& it) const { return it.node == node; }
-
-        bool operator==(const iterator&& it) const { return it.node == node; }
-
-        bool operator!=(const iterator& it) const { return it.node != node; }
-
-        bool operator!=(const iterator&& it) const { return it.node != node; }
-
-        T operator*() const { return node->value; }
-
-        T* operator->() const { return &node->value; }
-
-        iterator& operator++() {
-            node = get_next_vertex(node);
-            return *this;
-        }
-
-        iterator operator++(int) {
-            iterator temp = iterator(node);
-            ++(*this);
-            return temp;
-        }
-
-        iterator& operator--() {
-            node = get_prev_vertex(node);
-            return *this;
-        }
-
-        iterator operator--(int) {
-            iterator temp = iterator(node);
-            --(*this);
-            return temp;
-        }
-
-    private:
-        int get_parent_direction(Node* child) {
-            return child->parent->left == child ? Node::LEFT : Node::RIGHT;
-        }
-
-        Node* get_leftest_node(Node* node) {
-            while (node->left != nullptr) {
-                node = node->left;
-            }
-            return node;
-        }
-
-        Node* get_rightest_node(Node* node) {
-            while (node->right) {
-                node = node->right;
-            }
-            return node;
-        }
-
-        // Auxiliary method for finding next node in tree.
-        Node* get_next_vertex(Node* node) {
-            if (node->right != nullptr) {
-                return get_leftest_node(node->right);
-            }
-            while (node->parent) {
-                int32_t dir = get_parent_direction(node);
-                node = node->parent;
-                if (dir == Node::LEFT) {
-                    return node;
-                }
-            }
-            return nullptr;
-        }
-
-        // Auxiliary method for finding previous node in tree.
-        Node* get_prev_vertex(Node* node) {
-            if (node->left != nullptr) {
-                return get_rightest_node(node->left);
-            }
-            while (node->parent) {
-                int32_t dir = get_parent_direction(node);
-                node = node->parent;
-                if (dir == Node::RIGHT) {
-                    return node;
-                }
-            }
-            return nullptr;
-        }
-
-        Node* node = nullptr;
-    };
-
-private:
-    Node* get_leftest_node(Node* node) {
-        while (node->left != nullptr) {
-            node = node->left;
-        }
-        return node;
-    }
-
-    int32_t get_height(Node* node) { return node == nullptr ? Node::UNDEFINED : node->height; }
-
-    int32_t height_difference(Node* node) {
-        return node ? get_height(node->left) - get_height(node->right) : 0;
-    }
-
-    // Auxiliary function for deleting tree and releasing memory.
-    void destroy(Node* node) {
-        if (node == nullptr) {
-            return;
-        }
-        destroy(node->left);
-        destroy(node->right);
-        delete node;
-    }
-
-    void destroy() { destroy(root->left); }
-
-    void update_height(Node* node) {
-        node->height = 1 + std::max(get_height(node->left), get_height(node->right));
-    }
-
-    Node* left_rotate(Node* node) {
-        Node* temp = node->right;
-        node->right = temp->left;
-        if (temp->left) {
-            temp->left->parent = node;
-        }
-        temp->left = node;
-        temp->parent = node->parent;
-        node->parent = temp;
-        update_height(node);
-        update_height(temp);
-        return temp;
-    }
-
-    Node* right_rotate(Node* node) {
-        Node* temp = node->left;
-        node->left = temp->right;
-        if (temp->right) {
-            temp->right->parent = node;
-        }
-        temp->right = node;
-        temp->parent = node->parent;
-        node->parent = temp;
-        update_height(node);
-        update_height(temp);
-        return temp;
-    }
-
-    Node* big_left_rotate(Node* node) {
-        node->right = right_rotate(node->right);
-        return left_rotate(node);
-    }
-
-    Node* big_right_rotate(Node* node) {
-        node->left = left_rotate(node->left);
-        return right_rotate(node);
-    }
-
-    // Standard AVL's rotate implementation.
-    Node* rotate(Node* node) {
-        int32_t n_diff = height_difference(node);
-        int32_t l_diff = height_difference(node->left);
-        int32_t r_diff = height_difference(node->right);
-        if (n_diff == -TWO) {
-            if (r_diff == ONE) {
-                node = big_left_rotate(node);
-            } else {
-                node = left_rotate(node);
-            }
-        } else if (n_diff == TWO) {
-            if (l_diff == -ONE) {
-                node = big_right_rotate(node);
-            } else {
-                node = right_rotate(node);
-            }
-        }
-        return node;
-    }
-
-    // Auxiliary function for erasing element from tree.
-    Node* recursive_erase(Node* node, const T& val) {
-        if (node == nullptr) {
-            return node;
-        }
-        if (val < node->value) {
-            node->left = recursive_erase(node->left, val);
-            if (node->left) {
-                node->left->parent = node;
-            }
-        } else if (node->value < val) {
-            node->right = recursive_erase(node->right, val);
-            if (node->right) {
-                node->right->parent = node;
-            }
-        } else {
-            if (node->left && node->right) {
-                Node* temp = get_leftest_node(node->right);
-                node->value = temp->value;
-                node->right = recursive_erase(node->right, temp->value);
-                if (node->right) {
-                    node->right->parent = node;
-                }
-            } else {
-                Node* temp = node->left ? node->left : node->right;
-                delete node;
-                --node_count;
-                node = temp;
-                if (node) {
-                    node->parent = nullptr;
-                }
-            }
-        }
-        if (node == nullptr) {
-            return node;
-        }
-        node = rotate(node);
-        update_height(node);
-        return node;
-    }
-
-    // Auxiliary function for inserting element from tree.
-    Node* recursive_insert(Node* node, const T& val) {
-        if (node == nullptr) {
-            node = new Node(val);
-            ++node_count;
-        } else if (val < node->value) {
-            node->left = recursive_insert(node->left, val);
-            node->left->parent = node;
-        } else if (node->value < val) {
-            node->right = recursive_insert(node->right, val);
-            node->right->parent = node;
-        }
-        node = rotate(node);
-        update_height(node);
-        return node;
-    }
-
-    size_t node_count = 0;
-    Node* root;
-    static constexpr int32_t ONE = 1;
-    static constexpr int32_t TWO = 2;
-};
-
 const int STEP = 1 << 9;
 const int B = 1 << 14;
 const int N = STEP * B;
@@ -505,6 +125,62 @@ void lb() {
     cout << endl;
 }
 
+// lb() workload for unsigned keys: [-MAXC, MAXC] is shifted to [0, 2 * MAXC].
+void lb_integer() {
+    const int MAXC = 1e9;
+    uniform_int_distribution<int> gen_std(-MAXC, MAXC);
+    uniform_int_distribution<int> gen_my(-MAXC, MAXC);
+    mt19937 rnd_std(512);
+    mt19937 rnd_my(512);
+    vector<int> arr_n(B);
+    for (int q = 0; q < B; ++q) arr_n[q] = STEP * q;
+    vector<long long> stime(B);
+    vector<long long> mtime(B);
+    long long sum_std = 0;
+    for (int i = 0; i < ITER; ++i) {
+        set<unsigned> std_set;
+        for (int j = 0; j < B; ++j) {
+            for (int k = 0; k < STEP; ++k) {
+                std_set.insert(unsigned(gen_std(rnd_std) + MAXC));
+            }
+            auto start_std = timeStamp();
+            for (int k = 0; k < STEP; ++k) {
+                const auto it = std_set.lower_bound(unsigned(gen_std(rnd_std) + MAXC));
+                sum_std += it == std_set.end() ? 0 : *it;
+            }
+            stime[j] += duration_nano(timeStamp() - start_std);
+        }
+    }
+    long long sum_my = 0;
+    for (int i = 0; i < ITER; ++i) {
+        IntegerSet<unsigned> my_set;
+        for (int j = 0; j < B; ++j) {
+            for (int k = 0; k < STEP; ++k) {
+                my_set.insert(unsigned(gen_my(rnd_my) + MAXC));
+            }
+            auto start_my = timeStamp();
+            for (int k = 0; k < STEP; ++k) {
+                const auto it = my_set.lower_bound(unsigned(gen_my(rnd_my) + MAXC));
+                sum_my += it == my_set.end() ? 0 : *it;
+            }
+            mtime[j] += duration_nano(timeStamp() - start_my);
+        }
+    }
+    for (auto &i : stime) i /= ITER;
+    for (auto &i : mtime) i /= ITER;
+    while (arr_n[0] < STEP * 4) {
+        arr_n.erase(arr_n.begin());
+        stime.erase(stime.begin());
+        mtime.erase(mtime.begin());
+    }
+    for (long long i : arr_n) cout << i << " "; cout << endl;
+    for (long long i : stime) cout << i << " "; cout << endl;
+    for (long long i : mtime) cout << i << " "; cout << endl;
+    cout << "sum_std = " << sum_std << endl;
+    cout << "sum_my  = " << sum_my << endl;
+    cout << endl;
+}
+
 void add_erase() {
     const int MAXC = 1e9;
     uniform_int_distribution<int> gen_std(-MAXC, MAXC);
@@ -556,8 +232,867 @@ void add_erase() {
     cout << endl;
 }
 
+// Mostly increasing keys, like timestamps, inserted with hint end().
+void add_sequential() {
+    uniform_int_distribution<int> gen_std(0, 3);
+    uniform_int_distribution<int> gen_my(0, 3);
+    mt19937 rnd_std(512);
+    mt19937 rnd_my(512);
+    vector<int> arr_n(B);
+    for (int q = 0; q < B; ++q) arr_n[q] = STEP * q;
+    vector<long long> stime(B);
+    vector<long long> mtime(B);
+    long long sum_std = 0;
+    for (int i = 0; i < ITER; ++i) {
+        set<int> std_set;
+        int key = 0;
+        auto start_std = timeStamp();
+        for (int j = 0; j < B; ++j) {
+            for (int k = 0; k < STEP; ++k) {
+                key += gen_std(rnd_std);
+                std_set.insert(std_set.end(), key);
+            }
+            stime[j] += duration_nano(timeStamp() - start_std);
+        }
+        for (int i : std_set) sum_std += i;
+    }
+    long long sum_my = 0;
+    for (int i = 0; i < ITER; ++i) {
+        Set<int> my_set;
+        int key = 0;
+        auto start_my = timeStamp();
+        for (int j = 0; j < B; ++j) {
+            for (int k = 0; k < STEP; ++k) {
+                key += gen_my(rnd_my);
+                my_set.insert(my_set.end(), key);
+            }
+            mtime[j] += duration_nano(timeStamp() - start_my);
+        }
+        for (int i : my_set) sum_my += i;
+    }
+    for (auto &i : stime) i /= ITER;
+    for (auto &i : mtime) i /= ITER;
+    while (arr_n[0] < STEP * 4) {
+        arr_n.erase(arr_n.begin());
+        stime.erase(stime.begin());
+        mtime.erase(mtime.begin());
+    }
+    for (long long i : arr_n) cout << i << " "; cout << endl;
+    for (long long i : stime) cout << i << " "; cout << endl;
+    for (long long i : mtime) cout << i << " "; cout << endl;
+    cout << "sum_std = " << sum_std << endl;
+    cout << "sum_my  = " << sum_my << endl;
+    cout << endl;
+}
+
+// Process start with existing set and few lookups: rebuilding std::set from saved sorted keys against opening
+// of MappedSet, which pages in only nodes on the lookup paths.
+void mapped_startup() {
+    const int n = N / 4;
+    const int q = 1000;
+    const char *saved_path = "bench_saved.bin", *mapped_path = "bench_mapped.bin";
+    mt19937 rnd(321);
+    vector<int> keys(n);
+    for (int &k : keys) k = int(rnd());
+    {
+        set<int> sorted(keys.begin(), keys.end());
+        vector<int> saved(sorted.begin(), sorted.end());
+        ofstream out(saved_path, ios::binary);
+        out.write(reinterpret_cast<const char *>(saved.data()), streamsize(saved.size() * sizeof(int)));
+        remove(mapped_path);
+        MappedSet<int> mapped(mapped_path);
+        for (int k : keys) mapped.insert(k);
+        mapped.sync();
+    }
+    long long sum = 0;
+    long long load_time = 0, mapped_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        auto start = timeStamp();
+        ifstream in(saved_path, ios::binary);
+        set<int> loaded;
+        for (int k; in.read(reinterpret_cast<char *>(&k), sizeof(k));) loaded.insert(loaded.end(), k);
+        for (int k = 0; k < q; ++k) sum += loaded.count(keys[rnd() % n]);
+        load_time += duration_micro(timeStamp() - start);
+        start = timeStamp();
+        MappedSet<int> mapped(mapped_path, true);
+        for (int k = 0; k < q; ++k) sum += mapped.find(keys[rnd() % n]) != mapped.end();
+        mapped_time += duration_micro(timeStamp() - start);
+    }
+    remove(saved_path);
+    remove(mapped_path);
+    cout << "std::set from file, us " << load_time / ITER << endl;
+    cout << "MappedSet, us " << mapped_time / ITER << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Time in ms of one workload on N keys: 0 - insert, 1 - insert/erase of present keys, 2 - lower_bound,
+// 3 - ordered scans of all keys.
+template<class S>
+long long run_workload(int workload) {
+    const int MAXC = 1e9;
+    uniform_int_distribution<int> gen(-MAXC, MAXC);
+    mt19937 rnd(512);
+    vector<int> keys(N);
+    for (int &k : keys) k = gen(rnd);
+    S s;
+    long long sum = 0;
+    auto start = timeStamp();
+    for (int k : keys) s.insert(k);
+    if (workload == 0) return duration_milli(timeStamp() - start);
+    start = timeStamp();
+    if (workload == 1) {
+        for (int k = 0; k < N; ++k) {
+            s.erase(keys[k]);
+            keys[k] = gen(rnd);
+            s.insert(keys[k]);
+        }
+    } else if (workload == 2) {
+        for (int k = 0; k < N; ++k) {
+            const auto it = s.lower_bound(gen(rnd));
+            sum += it == s.end() ? 0 : *it;
+        }
+    } else {
+        for (int r = 0; r < 8; ++r) {
+            for (auto it = s.begin(); it != s.end(); ++it) sum += *it;
+        }
+    }
+    long long time = duration_milli(timeStamp() - start);
+    cout << (sum == 1 ? " " : "");
+    return time;
+}
+
+// Bucket size x workload: leaf buckets against one key per node. Scans of buckets read consecutive memory.
+void bucket_matrix() {
+    cout << "set insert insert_erase lower_bound scan" << endl;
+    const char *names[] = {"std::set", "Set", "BucketSet<16>", "BucketSet<32>", "BucketSet<64>"};
+    for (int kind = 0; kind < 5; ++kind) {
+        cout << names[kind];
+        for (int workload = 0; workload < 4; ++workload) {
+            long long time = 0;
+            for (int i = 0; i < ITER; ++i) {
+                if (kind == 0) time += run_workload<set<int>>(workload);
+                if (kind == 1) time += run_workload<Set<int>>(workload);
+                if (kind == 2) time += run_workload<BucketSet<int, 16>>(workload);
+                if (kind == 3) time += run_workload<BucketSet<int, 32>>(workload);
+                if (kind == 4) time += run_workload<BucketSet<int, 64>>(workload);
+            }
+            cout << " " << time / ITER;
+        }
+        cout << endl;
+    }
+    cout << endl;
+}
+
+// Dense ID ranges: inserts and lookups in Set, IntegerSet and RoaringSet, then union and intersection
+// of two such sets: std::set_union/std::set_intersection over std::set against bulk operations of RoaringSet.
+void dense_ids() {
+    const int n = N / 2;
+    const int q = N / 2;
+    mt19937 rnd(2024);
+    // Blocks of 256 - 1279 consecutive ids, separated by gaps of 1024 ids.
+    vector<unsigned> a, b;
+    for (unsigned id = 0; a.size() < size_t(n); id += 1024) {
+        unsigned length = 256 + rnd() % 1024;
+        for (unsigned k = 0; k < length && a.size() < size_t(n); ++k) a.push_back(id + k);
+        id += length;
+    }
+    for (unsigned id : a) if (rnd() % 2) b.push_back(id + 512);
+    vector<unsigned> queries(q);
+    for (unsigned &k : queries) k = rnd() % (a.back() + 1);
+    long long sum = 0;
+    long long set_time = 0, integer_time = 0, roaring_time = 0, std_bulk_time = 0, roaring_bulk_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        auto start = timeStamp();
+        Set<unsigned> my_set;
+        for (unsigned k : a) my_set.insert(k);
+        for (unsigned k : queries) sum += my_set.find(k) != my_set.end();
+        set_time += duration_milli(timeStamp() - start);
+        start = timeStamp();
+        IntegerSet<unsigned> integer_set;
+        for (unsigned k : a) integer_set.insert(k);
+        for (unsigned k : queries) sum += integer_set.find(k) != integer_set.end();
+        integer_time += duration_milli(timeStamp() - start);
+        start = timeStamp();
+        RoaringSet roaring;
+        for (unsigned k : a) roaring.insert(k);
+        for (unsigned k : queries) sum += roaring.find(k) != roaring.end();
+        roaring_time += duration_milli(timeStamp() - start);
+
+        set<unsigned> std_a(a.begin(), a.end()), std_b(b.begin(), b.end());
+        RoaringSet roaring_b(b.begin(), b.end());
+        start = timeStamp();
+        vector<unsigned> united, common;
+        set_union(std_a.begin(), std_a.end(), std_b.begin(), std_b.end(), back_inserter(united));
+        set_intersection(std_a.begin(), std_a.end(), std_b.begin(), std_b.end(), back_inserter(common));
+        sum += united.size() + common.size();
+        std_bulk_time += duration_milli(timeStamp() - start);
+        start = timeStamp();
+        sum += (roaring | roaring_b).size() + (roaring & roaring_b).size();
+        roaring_bulk_time += duration_milli(timeStamp() - start);
+    }
+    cout << "insert + find: Set " << set_time / ITER << ", IntegerSet " << integer_time / ITER << ", RoaringSet "
+         << roaring_time / ITER << endl;
+    cout << "union + intersection: std::set " << std_bulk_time / ITER << ", RoaringSet " << roaring_bulk_time / ITER
+         << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Allocated port and ID ranges: points one by one in Set against runs of IntervalSet, then release of half of ranges.
+void interval_ranges() {
+    const int ranges = N / 64;
+    const int q = N / 4;
+    mt19937 rnd(99);
+    vector<pair<int, int>> allocated(ranges);
+    for (auto &r : allocated) {
+        r.first = int(rnd() >> 2);
+        r.second = r.first + 1 + int(rnd() % 128);
+    }
+    vector<int> queries(q);
+    for (int &k : queries) k = rnd() % 2 ? int(rnd() >> 2) : allocated[rnd() % ranges].first + int(rnd() % 64);
+    long long sum = 0;
+    long long set_time = 0, interval_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        auto start = timeStamp();
+        Set<int> points;
+        for (auto &r : allocated) {
+            for (int k = r.first; k < r.second; ++k) points.insert(k);
+        }
+        for (int k : queries) sum += points.find(k) != points.end();
+        for (int j = 0; j < ranges; j += 2) {
+            for (int k = allocated[j].first; k < allocated[j].second; ++k) points.erase(k);
+        }
+        sum += points.size();
+        set_time += duration_milli(timeStamp() - start);
+        start = timeStamp();
+        IntervalSet<int> runs;
+        for (auto &r : allocated) runs.insert_range(r.first, r.second);
+        for (int k : queries) sum += runs.contains(k);
+        for (int j = 0; j < ranges; j += 2) runs.erase_range(allocated[j].first, allocated[j].second);
+        sum += runs.size();
+        interval_time += duration_milli(timeStamp() - start);
+        if (i == 0) cout << "points = " << runs.size() << ", runs = " << runs.run_count() << endl;
+    }
+    cout << "Set " << set_time / ITER << endl;
+    cout << "IntervalSet " << interval_time / ITER << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// URL-like key: long common prefix, then path with random ids.
+string gen_url(mt19937 &rnd) {
+    uniform_int_distribution<int> gen_user(0, 1e6);
+    uniform_int_distribution<int> gen_item(0, 1e3);
+    return "https://www.example.com/users/" + to_string(gen_user(rnd)) + "/items/" + to_string(gen_item(rnd));
+}
+
+// lb() workload for URL-like string keys. Fewer keys, as each of them is much larger.
+void lb_string() {
+    const int B_STR = B / 16;
+    mt19937 rnd_std(512);
+    mt19937 rnd_my(512);
+    vector<int> arr_n(B_STR);
+    for (int q = 0; q < B_STR; ++q) arr_n[q] = STEP * q;
+    vector<long long> stime(B_STR);
+    vector<long long> mtime(B_STR);
+    vector<string> queries(STEP);
+    long long sum_std = 0;
+    for (int i = 0; i < ITER; ++i) {
+        set<string> std_set;
+        for (int j = 0; j < B_STR; ++j) {
+            for (int k = 0; k < STEP; ++k) {
+                std_set.insert(gen_url(rnd_std));
+            }
+            for (auto &q : queries) q = gen_url(rnd_std);
+            auto start_std = timeStamp();
+            for (int k = 0; k < STEP; ++k) {
+                const auto it = std_set.lower_bound(queries[k]);
+                sum_std += it == std_set.end() ? 0 : it->size();
+            }
+            stime[j] += duration_nano(timeStamp() - start_std);
+        }
+    }
+    long long sum_my = 0;
+    for (int i = 0; i < ITER; ++i) {
+        Set<string> my_set;
+        for (int j = 0; j < B_STR; ++j) {
+            for (int k = 0; k < STEP; ++k) {
+                my_set.insert(gen_url(rnd_my));
+            }
+            for (auto &q : queries) q = gen_url(rnd_my);
+            auto start_my = timeStamp();
+            for (int k = 0; k < STEP; ++k) {
+                const auto it = my_set.lower_bound(queries[k]);
+                sum_my += it == my_set.end() ? 0 : it->size();
+            }
+            mtime[j] += duration_nano(timeStamp() - start_my);
+        }
+    }
+    for (auto &i : stime) i /= ITER;
+    for (auto &i : mtime) i /= ITER;
+    while (arr_n[0] < STEP * 4) {
+        arr_n.erase(arr_n.begin());
+        stime.erase(stime.begin());
+        mtime.erase(mtime.begin());
+    }
+    for (long long i : arr_n) cout << i << " "; cout << endl;
+    for (long long i : stime) cout << i << " "; cout << endl;
+    for (long long i : mtime) cout << i << " "; cout << endl;
+    cout << "sum_std = " << sum_std << endl;
+    cout << "sum_my  = " << sum_my << endl;
+    cout << endl;
+}
+
+// Balancing policy x workload matrix.
+void balance_matrix() {
+    cout << "policy insert insert_erase lower_bound" << endl;
+    const char *names[] = {"std::set", "AVL", "red-black", "WAVL"};
+    for (int policy = 0; policy < 4; ++policy) {
+        cout << names[policy];
+        for (int workload = 0; workload < 3; ++workload) {
+            long long time = 0;
+            for (int i = 0; i < ITER; ++i) {
+                if (policy == 0) time += run_workload<set<int>>(workload);
+                if (policy == 1) time += run_workload<Set<int, 0, AvlBalance>>(workload);
+                if (policy == 2) time += run_workload<Set<int, 0, RedBlackBalance>>(workload);
+                if (policy == 3) time += run_workload<Set<int, 0, WavlBalance>>(workload);
+            }
+            cout << " " << time / ITER;
+        }
+        cout << endl;
+    }
+    cout << endl;
+}
+
+template<class S>
+void enable_cache(S &, size_t) {}
+
+template<class T>
+void enable_cache(Set<T> &s, size_t entries) { s.set_lookup_cache(entries); }
+
+// Time in ms of q finds of keys, drawn from Zipf distribution with given exponent over n random keys.
+template<class S>
+long long run_zipf(int n, int q, double exponent, long long &sum, size_t cache_entries = 0) {
+    mt19937 rnd(512);
+    vector<int> keys(n);
+    for (int &k : keys) k = int(rnd() >> 1);
+    vector<double> cdf(n);
+    double total = 0;
+    for (int r = 0; r < n; ++r) cdf[r] = total += 1 / pow(r + 1, exponent);
+    uniform_real_distribution<double> gen(0, total);
+    vector<int> queries(q);
+    for (int &k : queries) k = keys[lower_bound(cdf.begin(), cdf.end(), gen(rnd)) - cdf.begin()];
+    S s;
+    enable_cache(s, cache_entries);
+    for (int k : keys) s.insert(k);
+    auto start = timeStamp();
+    for (int k : queries) sum += s.find(k) != s.end();
+    return duration_milli(timeStamp() - start);
+}
+
+// Skewed lookups: balanced trees against splay tree and AVL tree with lookup cache.
+void lb_zipf() {
+    const int n = N / 8;
+    const int q = N / 4;
+    const size_t CACHE = 1 << 12;
+    long long sum = 0;
+    cout << "exponent std::set AVL splay AVL+cache" << endl;
+    for (double exponent : {0.99, 1.5}) {
+        long long std_time = 0, avl_time = 0, splay_time = 0, cache_time = 0;
+        for (int i = 0; i < ITER; ++i) {
+            std_time += run_zipf<set<int>>(n, q, exponent, sum);
+            avl_time += run_zipf<Set<int>>(n, q, exponent, sum);
+            splay_time += run_zipf<Set<int, 0, SplayBalance>>(n, q, exponent, sum);
+            cache_time += run_zipf<Set<int>>(n, q, exponent, sum, CACHE);
+        }
+        cout << exponent << " " << std_time / ITER << " " << avl_time / ITER << " " << splay_time / ITER << " "
+             << cache_time / ITER << endl;
+    }
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Lookups, 90% of which are for absent keys: plain tree against tree with Bloom filter.
+void find_absent() {
+    const int n = N / 8;
+    const int q = N / 4;
+    const size_t BITS_PER_KEY = 10;
+    mt19937 rnd(512);
+    vector<int> keys(n);
+    for (int &k : keys) k = int(rnd() >> 2) * 2;
+    vector<int> queries(q);
+    for (int &k : queries) k = rnd() % 10 == 0 ? keys[rnd() % n] : int(rnd() >> 2) * 2 + 1;
+    long long sum = 0;
+    long long std_time = 0, my_time = 0, bloom_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        set<int> std_set(keys.begin(), keys.end());
+        auto start = timeStamp();
+        for (int k : queries) sum += std_set.find(k) != std_set.end();
+        std_time += duration_milli(timeStamp() - start);
+        Set<int> my_set(keys.begin(), keys.end());
+        start = timeStamp();
+        for (int k : queries) sum += my_set.find(k) != my_set.end();
+        my_time += duration_milli(timeStamp() - start);
+        my_set.set_bloom_filter(BITS_PER_KEY);
+        start = timeStamp();
+        for (int k : queries) sum += my_set.find(k) != my_set.end();
+        bloom_time += duration_milli(timeStamp() - start);
+        if (i == 0) {
+            auto stats = my_set.bloom_filter_stats();
+            cout << "filter memory = " << stats.memory << ", false positive rate = " << stats.false_positive_rate << endl;
+        }
+    }
+    cout << "std::set " << std_time / ITER << endl;
+    cout << "Set " << my_time / ITER << endl;
+    cout << "Set+bloom " << bloom_time / ITER << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Burst of random inserts: immediate inserts against buffered ones, flushed by the final lookup.
+void add_buffered() {
+    const int n = N / 2;
+    const size_t LIMIT = 1 << 20;
+    mt19937 rnd(512);
+    vector<int> keys(n);
+    for (int &k : keys) k = int(rnd());
+    long long sum = 0;
+    long long std_time = 0, my_time = 0, buffered_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        auto start = timeStamp();
+        set<int> std_set;
+        for (int k : keys) std_set.insert(k);
+        sum += std_set.count(keys[0]);
+        std_time += duration_milli(timeStamp() - start);
+        start = timeStamp();
+        Set<int> my_set;
+        for (int k : keys) my_set.insert(k);
+        sum += my_set.contains(keys[0]);
+        my_time += duration_milli(timeStamp() - start);
+        start = timeStamp();
+        Set<int> buffered_set;
+        buffered_set.set_write_buffer(LIMIT);
+        for (int k : keys) buffered_set.insert(k);
+        sum += buffered_set.contains(keys[0]);
+        buffered_time += duration_milli(timeStamp() - start);
+    }
+    cout << "std::set " << std_time / ITER << endl;
+    cout << "Set " << my_time / ITER << endl;
+    cout << "Set+buffer " << buffered_time / ITER << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Bursts of erasures, followed by reinsertion of the same keys: eager erase against lazy one.
+template<typename S>
+long long erase_bursts(S& s, const vector<int>& keys, long long& sum) {
+    const int BURSTS = 8;
+    auto start = timeStamp();
+    for (int k : keys) s.insert(k);
+    for (int b = 0; b < BURSTS; ++b) {
+        size_t from = keys.size() / BURSTS * b, to = from + keys.size() / 4;
+        for (size_t i = from; i < to && i < keys.size(); ++i) s.erase(keys[i]);
+        for (size_t i = 0; i < keys.size(); i += 7) sum += s.find(keys[i]) != s.end();
+        for (size_t i = from; i < to && i < keys.size(); ++i) s.insert(keys[i]);
+    }
+    return duration_milli(timeStamp() - start);
+}
+
+void erase_lazy() {
+    const int n = N / 8;
+    mt19937 rnd(777);
+    vector<int> keys(n);
+    for (int &k : keys) k = int(rnd());
+    long long sum = 0;
+    long long std_time = 0, my_time = 0, lazy_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        set<int> std_set;
+        std_time += erase_bursts(std_set, keys, sum);
+        Set<int> my_set;
+        my_time += erase_bursts(my_set, keys, sum);
+        Set<int> lazy_set;
+        lazy_set.set_lazy_erase(0.5);
+        lazy_time += erase_bursts(lazy_set, keys, sum);
+    }
+    cout << "std::set " << std_time / ITER << endl;
+    cout << "Set " << my_time / ITER << endl;
+    cout << "Set+lazy erase " << lazy_time / ITER << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Fills set with keys and returns time of clear(). Work, left to background thread, isn't counted.
+template<typename S, typename K>
+long long teardown_time(S& s, const vector<K>& keys) {
+    for (const K& k : keys) s.insert(k);
+    auto start = timeStamp();
+    s.clear();
+    return duration_milli(timeStamp() - start);
+}
+
+template<typename K>
+void teardown_keys(const vector<K>& keys) {
+    long long std_time = 0, my_time = 0, background_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        set<K> std_set;
+        std_time += teardown_time(std_set, keys);
+        Set<K> my_set;
+        my_time += teardown_time(my_set, keys);
+        Set<K> background_set;
+        background_set.set_background_teardown(true);
+        background_time += teardown_time(background_set, keys);
+    }
+    cout << "std::set " << std_time / ITER << endl;
+    cout << "Set " << my_time / ITER << endl;
+    cout << "Set+background teardown " << background_time / ITER << endl;
+    cout << endl;
+}
+
+void teardown() {
+    mt19937 rnd(2024);
+    vector<int> keys(N);
+    for (int &k : keys) k = int(rnd());
+    cout << "int keys" << endl;
+    teardown_keys(keys);
+    vector<string> urls(N / 4);
+    for (string &url : urls) url = gen_url(rnd);
+    cout << "string keys" << endl;
+    teardown_keys(urls);
+}
+
+// Random updates with a point-in-time view taken every SNAPSHOT_EVERY of them: copies of Set against
+// O(1) snapshots of PersistentSet. Each view is read once, before next one replaces it.
+template<typename S>
+long long updates_with_snapshots(const vector<int>& keys, long long& sum) {
+    const size_t SNAPSHOT_EVERY = 1 << 12;
+    auto start = timeStamp();
+    S s;
+    S view;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] & 1) {
+            s.insert(keys[i]);
+        } else {
+            s.erase(keys[i] ^ 2);
+        }
+        if (i % SNAPSHOT_EVERY == 0) {
+            view = s;
+            sum += view.size() + *view.begin();
+        }
+    }
+    return duration_milli(timeStamp() - start);
+}
+
+void snapshots() {
+    const int n = N / 4;
+    mt19937 rnd(45);
+    vector<int> keys(n);
+    for (int &k : keys) k = int(rnd() % (n / 2));
+    long long sum = 0;
+    long long my_time = 0, persistent_time = 0;
+    for (int i = 0; i < ITER; ++i) {
+        my_time += updates_with_snapshots<Set<int>>(keys, sum);
+        persistent_time += updates_with_snapshots<PersistentSet<int>>(keys, sum);
+    }
+    cout << "Set copies " << my_time / ITER << endl;
+    cout << "PersistentSet snapshots " << persistent_time / ITER << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Difference between yesterday's and today's version after few changes: diff() against full merge
+// of both versions and against diff() of unrelated sets with the same keys.
+void diff_versions() {
+    const int n = N / 4;
+    const int CHANGES = 1000;
+    mt19937 rnd(46);
+    PersistentSet<int> yesterday;
+    for (int i = 0; i < n; ++i) yesterday.insert(int(rnd()));
+    PersistentSet<int> today = yesterday;
+    for (int i = 0; i < CHANGES; ++i) {
+        today.insert(int(rnd()));
+        today.erase(*today.lower_bound(int(rnd())));
+    }
+    PersistentSet<int> copy(today.begin(), today.end());
+    long long sum = 0;
+    auto count = [&sum](int) { ++sum; };
+    auto start = timeStamp();
+    diff(yesterday, today, count, count);
+    long long diff_time = duration_micro(timeStamp() - start);
+    start = timeStamp();
+    auto it = yesterday.begin();
+    auto jt = today.begin();
+    while (it != yesterday.end() && jt != today.end()) {
+        if (*it < *jt) {
+            ++sum;
+            ++it;
+        } else if (*jt < *it) {
+            ++sum;
+            ++jt;
+        } else {
+            ++it;
+            ++jt;
+        }
+    }
+    long long merge_time = duration_micro(timeStamp() - start);
+    start = timeStamp();
+    diff(yesterday, copy, count, count);
+    long long unrelated_time = duration_micro(timeStamp() - start);
+    cout << "diff, us " << diff_time << endl;
+    cout << "merge, us " << merge_time << endl;
+    cout << "diff of unrelated sets, us " << unrelated_time << endl;
+    cout << "sum = " << sum << endl;
+    cout << endl;
+}
+
+// Set, shared between threads under one mutex.
+struct LockedSet {
+    bool contains(int val) {
+        lock_guard<mutex> lock(m);
+        return s.contains(val);
+    }
+
+    void insert(int val) {
+        lock_guard<mutex> lock(m);
+        s.insert(val);
+    }
+
+    void erase(int val) {
+        lock_guard<mutex> lock(m);
+        s.erase(val);
+    }
+
+    mutex m;
+    Set<int> s;
+};
+
+// Runs total_ops random operations on keys [0, range), split between threads; returns ms.
+template<typename S>
+long long mixed_ops(S &s, int threads, int read_percent, int range, int total_ops) {
+    vector<thread> pool;
+    atomic<long long> found{0};
+    auto start = timeStamp();
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            mt19937 rnd(t + 47);
+            long long local = 0;
+            for (int i = 0; i < total_ops / threads; ++i) {
+                int key = int(rnd() % range);
+                int op = int(rnd() % 100);
+                if (op < read_percent) {
+                    local += s.contains(key);
+                } else if ((op - read_percent) % 2 == 0) {
+                    s.insert(key);
+                } else {
+                    s.erase(key);
+                }
+            }
+            found += local;
+        });
+    }
+    for (auto &th: pool) th.join();
+    long long time = duration_milli(timeStamp() - start);
+    cout << "(" << found << ") ";
+    return time;
+}
+
+// Throughput of ConcurrentSet against Set under a mutex, by number of threads and share of reads.
+void concurrent_mix() {
+    const int range = N / 4;
+    const int total_ops = N / 2;
+    for (int read_percent: {100, 90, 50}) {
+        for (int threads: {1, 2, 4, 8, 16, 32}) {
+            LockedSet locked;
+            ConcurrentSet<int> concurrent;
+            mt19937 rnd(470);
+            for (int i = 0; i < range / 2; ++i) {
+                int key = int(rnd() % range);
+                locked.s.insert(key);
+                concurrent.insert(key);
+            }
+            cout << read_percent << "% reads, " << threads << " threads" << endl;
+            cout << "Set + mutex, ms " << mixed_ops(locked, threads, read_percent, range, total_ops) << endl;
+            cout << "ConcurrentSet, ms " << mixed_ops(concurrent, threads, read_percent, range, total_ops) << endl;
+        }
+    }
+    cout << endl;
+}
+
+// Scaling with cores: each thread does the same work, so ideal time stays flat as threads are added.
+// Speedup is throughput over the 1-thread run; it can't exceed the number of hardware threads.
+void concurrent_scaling() {
+    const int range = N / 4;
+    const int ops_per_thread = N / 8;
+    const int read_percent = 90;
+    cout << "hardware threads " << thread::hardware_concurrency() << ", " << read_percent << "% reads" << endl;
+    long long locked_base = 0, concurrent_base = 0;
+    for (int threads: {1, 2, 4, 8, 16}) {
+        LockedSet locked;
+        ConcurrentSet<int> concurrent;
+        mt19937 rnd(470);
+        for (int i = 0; i < range / 2; ++i) {
+            int key = int(rnd() % range);
+            locked.s.insert(key);
+            concurrent.insert(key);
+        }
+        long long locked_time = mixed_ops(locked, threads, read_percent, range, ops_per_thread * threads);
+        long long concurrent_time = mixed_ops(concurrent, threads, read_percent, range, ops_per_thread * threads);
+        if (threads == 1) {
+            locked_base = max(locked_time, 1LL);
+            concurrent_base = max(concurrent_time, 1LL);
+        }
+        cout << threads << " threads: Set + mutex " << locked_time << " ms, speedup "
+             << double(locked_base) * threads / max(locked_time, 1LL) << "; ConcurrentSet " << concurrent_time
+             << " ms, speedup " << double(concurrent_base) * threads / max(concurrent_time, 1LL) << endl;
+    }
+    cout << endl;
+}
+
+// Set, read under shared lock and updated under exclusive one.
+struct SharedLockedSet {
+    bool contains(int val) {
+        shared_lock<shared_mutex> lock(m);
+        return s.contains(val);
+    }
+
+    void insert(int val) {
+        unique_lock<shared_mutex> lock(m);
+        s.insert(val);
+    }
+
+    void erase(int val) {
+        unique_lock<shared_mutex> lock(m);
+        s.erase(val);
+    }
+
+    shared_mutex m;
+    Set<int> s;
+};
+
+// Readers run reads_per_thread lookups each, while one writer keeps updating; returns ms of readers.
+template<typename S>
+long long reads_with_writer(S &s, int readers, int range, int reads_per_thread) {
+    atomic<bool> stop{false};
+    thread writer([&] {
+        mt19937 rnd(48);
+        while (!stop) {
+            int key = int(rnd() % range);
+            if (rnd() % 2) {
+                s.insert(key);
+            } else {
+                s.erase(key);
+            }
+        }
+    });
+    vector<thread> pool;
+    atomic<long long> found{0};
+    auto start = timeStamp();
+    for (int t = 0; t < readers; ++t) {
+        pool.emplace_back([&, t] {
+            mt19937 rnd(t + 480);
+            long long local = 0;
+            for (int i = 0; i < reads_per_thread; ++i) {
+                local += s.contains(int(rnd() % range));
+            }
+            found += local;
+        });
+    }
+    for (auto &th: pool) th.join();
+    long long time = duration_milli(timeStamp() - start);
+    stop = true;
+    writer.join();
+    cout << "(" << found << ") ";
+    return time;
+}
+
+// Read scaling of RcuSet against Set under shared_mutex, with one concurrent writer.
+void rcu_readers() {
+    const int range = N / 4;
+    const int reads_per_thread = N / 16;
+    for (int readers: {1, 2, 4, 8, 16, 32}) {
+        SharedLockedSet locked;
+        RcuSet<int> rcu;
+        mt19937 rnd(480);
+        rcu.update([&](PersistentSet<int> &version) {
+            for (int i = 0; i < range / 2; ++i) {
+                int key = int(rnd() % range);
+                locked.s.insert(key);
+                version.insert(key);
+            }
+        });
+        cout << readers << " readers" << endl;
+        cout << "Set + shared_mutex, ms " << reads_with_writer(locked, readers, range, reads_per_thread) << endl;
+        cout << "RcuSet, ms " << reads_with_writer(rcu, readers, range, reads_per_thread) << endl;
+    }
+    cout << endl;
+}
+
+// Throughput of ShardedSet against Set under a mutex, by number of threads, for write-heavy loads.
+void sharded_mix() {
+    const int range = N / 4;
+    const int total_ops = N / 2;
+    for (int read_percent: {50, 10}) {
+        for (int threads: {1, 2, 4, 8, 16, 32}) {
+            LockedSet locked;
+            ShardedSet<int> sharded;
+            mt19937 rnd(490);
+            for (int i = 0; i < range / 2; ++i) {
+                int key = int(rnd() % range);
+                locked.s.insert(key);
+                sharded.insert(key);
+            }
+            cout << read_percent << "% reads, " << threads << " threads" << endl;
+            cout << "Set + mutex, ms " << mixed_ops(locked, threads, read_percent, range, total_ops) << endl;
+            cout << "ShardedSet, ms " << mixed_ops(sharded, threads, read_percent, range, total_ops) << endl;
+        }
+    }
+    cout << endl;
+}
+
+// Throughput of flat combining against Set under a mutex, by number of contending threads.
+void combining_mix() {
+    const int range = N / 4;
+    const int total_ops = N / 2;
+    for (int read_percent: {0, 50}) {
+        for (int threads: {1, 2, 4, 8, 16, 32, 64}) {
+            LockedSet locked;
+            CombiningSet<int> combining;
+            mt19937 rnd(500);
+            for (int i = 0; i < range / 2; ++i) {
+                int key = int(rnd() % range);
+                locked.s.insert(key);
+                combining.insert(key);
+            }
+            cout << read_percent << "% reads, " << threads << " threads" << endl;
+            cout << "Set + mutex, ms " << mixed_ops(locked, threads, read_percent, range, total_ops) << endl;
+            cout << "CombiningSet, ms " << mixed_ops(combining, threads, read_percent, range, total_ops) << endl;
+        }
+    }
+    cout << endl;
+}
+
 int main() {
     //add();
     //lb();
+    //lb_integer();
     //add_erase();
+    //add_sequential();
+    //mapped_startup();
+    //bucket_matrix();
+    //dense_ids();
+    //interval_ranges();
+    //lb_string();
+    //balance_matrix();
+    //lb_zipf();
+    //find_absent();
+    //add_buffered();
+    //erase_lazy();
+    //teardown();
+    //snapshots();
+    //diff_versions();
+    //concurrent_mix();
+    //concurrent_scaling();
+    //rcu_readers();
+    //sharded_mix();
+    //combining_mix();
 }
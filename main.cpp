@@ -1,4 +1,5 @@
 #include "Set.h"
+#include <iostream>
 #include <random>
 
 int main() {
@@ -13,4 +14,9 @@ int main() {
     for (auto par: set) {
         std::cout << par.first << " " << par.second << std::endl;
     }
+    auto range = set.equal_prefix_range(3);
+    std::cout << "Pairs starting with 3:" << std::endl;
+    for (auto it = range.first; it != range.second; ++it) {
+        std::cout << it->first << " " << it->second << std::endl;
+    }
 }
\ No newline at end of file
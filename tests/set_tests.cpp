@@ -0,0 +1,750 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../CombiningSet.h"
+#include "../ConcurrentSet.h"
+#include "../IntegerSet.h"
+#include "../IntervalSet.h"
+#include "../MappedSet.h"
+#include "../PersistentSet.h"
+#include "../RcuSet.h"
+#include "../RoaringSet.h"
+#include "../Set.h"
+#include "../ShardedSet.h"
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1);                                                             \
+        }                                                                             \
+    } while (false)
+
+// Failed load leaves the set unchanged, and corrupted count is reported as malformed input.
+void test_load_malformed() {
+    Set<int> saved{1, 2, 3};
+    std::stringstream out;
+    saved.save(out);
+    std::string data = out.str();
+    std::string truncated = data.substr(0, data.size() - 2);
+    std::string huge_count = data;
+    uint64_t count = ~uint64_t(0) / 2;
+    std::memcpy(&huge_count[16], &count, sizeof(count));
+    for (const std::string& input : {truncated, huge_count}) {
+        Set<int> set{7, 8};
+        std::stringstream in(input);
+        bool thrown = false;
+        try {
+            set.load(in);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        CHECK(thrown && set.size() == 2 && set.find(7) != set.end() && set.find(8) != set.end());
+    }
+    Set<int> set;
+    std::stringstream in(data);
+    set.load(in);
+    CHECK(set.size() == 3 && set.find(1) != set.end() && set.find(3) != set.end());
+}
+
+// Truncated, unsorted or unreadable run fails load_merged() after the merge has begun, and the set stays unchanged.
+template<size_t InlineCapacity>
+void test_load_merged_malformed() {
+    auto saved = [](std::initializer_list<int> keys) {
+        std::stringstream out;
+        Set<int>(keys).save(out);
+        return out.str();
+    };
+    std::string first = saved({1, 4, 9});
+    std::string second = saved({2, 4, 6, 8});
+    std::string truncated = second.substr(0, second.size() - 2);
+    std::string unsorted = second;
+    std::swap_ranges(&unsorted[24], &unsorted[28], &unsorted[28]);
+    std::string bad_header = second;
+    bad_header[0] ^= 1;
+    for (const std::string& broken : {truncated, unsorted, bad_header}) {
+        Set<int, InlineCapacity> set{7, 8, 10, 12, 14, 16};
+        std::stringstream good_run(first), broken_run(broken);
+        bool thrown = false;
+        try {
+            set.load_merged(std::vector<std::istream*>{&good_run, &broken_run});
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        CHECK(thrown && set.size() == 6 && *set.begin() == 7 && *--set.end() == 16);
+        set.insert(11);
+        CHECK(set.size() == 7 && set.contains(11) && set.contains(14));
+    }
+    Set<int, InlineCapacity> set{7, 8};
+    std::stringstream first_run(first), second_run(second);
+    set.load_merged(std::vector<std::istream*>{&first_run, &second_run});
+    std::vector<int> keys;
+    for (int val : set) {
+        keys.push_back(val);
+    }
+    CHECK(keys == std::vector<int>({1, 2, 4, 6, 8, 9}));
+}
+
+// Reopened file, grown a few times, gives the same keys, and header, pointing past the end of file, is rejected.
+void test_mapped_corrupted_header() {
+    const char* path = "mapped_set_test.bin";
+    std::remove(path);
+    {
+        MappedSet<int> set(path);
+        for (int i = 0; i < 5000; ++i) {
+            set.insert(i * 2);
+        }
+        set.sync();
+    }
+    {
+        MappedSet<int> set(path, true);
+        CHECK(set.size() == 5000 && *set.lower_bound(51) == 52 && *--set.end() == 9998);
+    }
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    uint64_t next = ~uint64_t(0) / 2;
+    file.seekp(32);
+    file.write(reinterpret_cast<const char*>(&next), sizeof(next));
+    file.close();
+    bool thrown = false;
+    try {
+        MappedSet<int> set(path, true);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(path);
+}
+
+// Backward iteration visits all keys, and decrement of begin() doesn't wrap around to the top of universe.
+template<class T>
+void test_integer_decrement() {
+    IntegerSet<T> set;
+    for (T val = 0; val < 200; val += 3) {
+        set.insert(val);
+    }
+    set.insert(std::numeric_limits<T>::max());
+    auto it = set.end();
+    CHECK(*--it == std::numeric_limits<T>::max());
+    for (int expected = 198; expected >= 0; expected -= 3) {
+        CHECK(*--it == T(expected));
+    }
+    CHECK(it == set.begin());
+    --it;
+    CHECK(it != set.begin() && it != set.end());
+    CHECK(*set.lower_bound(100) == 102 && *set.lower_bound(199) == std::numeric_limits<T>::max());
+}
+
+template<>
+struct UseIntegerSet<uint16_t> : std::true_type {};
+
+// OrderedSet is IntegerSet only for key types, which opted in.
+void test_ordered_set_opt_in() {
+    CHECK((std::is_same<OrderedSet<uint32_t>, Set<uint32_t>>::value));
+    CHECK((std::is_same<OrderedSet<uint16_t>, IntegerSet<uint16_t>>::value));
+    OrderedSet<uint16_t> set{7, 3, 65535};
+    CHECK(set.size() == 3 && *set.lower_bound(4) == 7);
+}
+
+// Run container, broken by erases, keeps its keys, and iterators work with standard algorithms.
+void test_roaring_broken_runs() {
+    RoaringSet set;
+    for (uint32_t i = 0; i < 60000; ++i) {
+        set.insert(i);
+    }
+    set.run_optimize();
+    for (uint32_t i = 0; i < 60000; i += 2) {
+        set.erase(i);
+    }
+    std::vector<uint32_t> keys(set.begin(), set.end());
+    CHECK(keys.size() == 30000 && std::distance(set.begin(), set.end()) == 30000);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        CHECK(keys[i] == 2 * i + 1);
+    }
+    CHECK(*std::prev(set.end()) == 59999 && *set.lower_bound(100) == 101 && set.find(100) == set.end());
+}
+
+// Runs, longer than the maximum of signed type, are counted without overflow.
+void test_interval_wide_runs() {
+    const int min = std::numeric_limits<int>::min();
+    const int max = std::numeric_limits<int>::max();
+    IntervalSet<int> set;
+    set.insert_range(min, max);
+    CHECK(set.size() == size_t(max) * 2 + 1 && set.run_count() == 1);
+    set.erase_range(-10, 10);
+    CHECK(set.size() == size_t(max) * 2 - 19 && set.run_count() == 2);
+    set.insert_range(-20, 20);
+    CHECK(set.size() == size_t(max) * 2 + 1 && set.run_count() == 1);
+    CHECK(set.contains(min) && !set.contains(max) && *set.lower_bound(5) == 5);
+}
+
+// Maximal value of type can't be stored, so insert and erase of it leave the set as it is.
+template<class T>
+void test_interval_max_value() {
+    const T max = std::numeric_limits<T>::max();
+    IntervalSet<T> set;
+    set.insert(max);
+    CHECK(set.empty() && !set.contains(max));
+    set.insert(T(max - 1));
+    set.erase(max);
+    CHECK(set.size() == 1 && set.contains(T(max - 1)) && !set.contains(max));
+}
+
+// Erasing node with two children moves the key of its successor, whose cache entry must not dangle.
+void test_cache_erase_compact() {
+    Set<std::string> set;
+    set.set_lookup_cache(1024);
+    for (int i = 0; i < 200; ++i) {
+        set.insert("key" + std::to_string(i));
+    }
+    for (int i = 0; i < 200; ++i) {
+        CHECK(set.contains("key" + std::to_string(i)));
+    }
+    for (int i = 0; i < 200; i += 3) {
+        set.erase("key" + std::to_string(i));
+    }
+    set.compact();
+    for (int i = 0; i < 200; ++i) {
+        std::string key = "key" + std::to_string(i);
+        CHECK(set.contains(key) == (i % 3 != 0));
+        CHECK(set.find(key) == (i % 3 != 0 ? set.lower_bound(key) : set.end()));
+    }
+}
+
+// Deleted nodes stay in the tree, so set without live keys isn't empty for compaction and key prefix.
+void test_lazy_erase_all_deleted() {
+    Set<int> ints;
+    ints.set_lazy_erase(1.0);
+    for (int i = 0; i < 100; ++i) {
+        ints.insert(i);
+    }
+    for (int i = 0; i < 100; ++i) {
+        ints.erase(i);
+    }
+    ints.compact(1000);
+    ints.insert(5);
+    ints.insert(200);
+    CHECK(ints.contains(5) && ints.contains(200) && ints.size() == 2);
+
+    Set<std::string> strings;
+    strings.set_lazy_erase(1.0);
+    strings.insert("abcX");
+    strings.insert("abcY");
+    strings.erase("abcX");
+    strings.erase("abcY");
+    strings.insert("zzz");
+    CHECK(strings.contains("zzz") && !strings.contains("abcY"));
+    CHECK(strings.size() == 1 && *strings.begin() == "zzz");
+}
+
+// Concurrent inserts into different ranges, with re-splits between them, keep all keys in order.
+void test_sharded_concurrent_insert() {
+    ShardedSet<int, 4> set;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&set, t]() {
+            for (int i = 0; i < 5000; ++i) {
+                set.insert(t * 5000 + i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(set.size() == 20000);
+    int expected = 0;
+    for (int val : set) {
+        CHECK(val == expected++);
+    }
+    int found = 0;
+    CHECK(set.lower_bound(12345, found) && found == 12345 && !set.lower_bound(20000, found));
+}
+
+// Key, which counts its live copies, to see when teardown is done. Destructor waits, while hold is set.
+struct LiveKey {
+    int val = 0;
+    static std::atomic<int> live;
+    static std::atomic<bool> hold;
+
+    LiveKey() { ++live; }
+
+    explicit LiveKey(int val_) : val(val_) { ++live; }
+
+    LiveKey(const LiveKey& other) : val(other.val) { ++live; }
+
+    LiveKey& operator=(const LiveKey& other) = default;
+
+    ~LiveKey() {
+        while (hold) {
+            std::this_thread::yield();
+        }
+        --live;
+    }
+
+    bool operator<(const LiveKey& other) const { return val < other.val; }
+};
+
+std::atomic<int> LiveKey::live{0};
+std::atomic<bool> LiveKey::hold{false};
+
+// Destructor and clear() return before background teardown is done, and turning it off waits for it.
+void test_background_teardown_drain() {
+    Set<LiveKey> kept;
+    kept.set_background_teardown(true);
+    int base = LiveKey::live;
+    for (int round = 0; round < 4; ++round) {
+        Set<LiveKey> dropped;
+        dropped.set_background_teardown(true);
+        for (int i = 0; i < 1000; ++i) {
+            dropped.insert(LiveKey(i));
+        }
+    }
+    for (int i = 0; i < 1000; ++i) {
+        kept.insert(LiveKey(i));
+    }
+    LiveKey::hold = true;
+    kept.clear();
+    CHECK(LiveKey::live > base && kept.empty());
+    std::thread release([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        LiveKey::hold = false;
+    });
+    kept.set_background_teardown(false);
+    CHECK(LiveKey::live == base);
+    release.join();
+}
+
+// Hinted insert flushes pending writes and doesn't follow the hint, whose node the flush has freed.
+void test_write_buffer_hinted_insert() {
+    Set<int> set;
+    for (int i = 0; i < 100; ++i) {
+        set.insert(i * 2);
+    }
+    set.set_write_buffer(1000);
+    Set<int>::iterator hint = set.find(50);
+    for (int i = 40; i < 60; i += 2) {
+        set.erase(i);
+    }
+    set.insert(1001);
+    Set<int>::iterator it = set.insert(hint, 51);
+    CHECK(*it == 51 && *++it == 60);
+    CHECK(set.size() == 92 && set.contains(1001) && !set.contains(50) && set.contains(51));
+    it = set.emplace_hint(set.end(), 53);
+    set.erase(51);
+    CHECK(*set.insert(set.find(53), 55) == 55 && !set.contains(51) && set.size() == 93);
+}
+
+// Operations, racing with re-splits, which replace splitters, still reach the shard of their key.
+void test_sharded_concurrent_resplit() {
+    const int range = 20000;
+    const int writers = 3;
+    ShardedSet<int, 8> set;
+    for (int k = 0; k < range; k += 4) {
+        set.insert(k);
+    }
+    std::vector<std::vector<int>> net(writers, std::vector<int>(range));
+    std::atomic<bool> done{false};
+    std::atomic<bool> failed{false};
+    std::thread splitter([&]() {
+        while (!done.load()) {
+            set.resplit();
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < writers; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 rnd(t + 49);
+            for (int i = 0; i < 30000; ++i) {
+                int key = int(rnd() % range);
+                int found = 0;
+                if (key % 4 == 0) {
+                    // Keys, divisible by 4, are never erased.
+                    if (!set.contains(key) || !set.lower_bound(key, found) || found != key) {
+                        failed = true;
+                    }
+                } else if (key % 4 == 1 + t) {
+                    if (rnd() % 2 == 0) {
+                        net[t][key] += !set.contains(key);
+                        set.insert(key);
+                    } else {
+                        net[t][key] -= set.contains(key);
+                        set.erase(key);
+                    }
+                } else if (set.lower_bound(key, found) && (found < key || found > key + 4)) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    done = true;
+    splitter.join();
+    CHECK(!failed);
+    size_t expected = 0;
+    for (int k = 0; k < range; ++k) {
+        bool present = k % 4 == 0 || net[k % 4 - 1][k] == 1;
+        CHECK(set.contains(k) == present);
+        expected += present;
+    }
+    CHECK(set.size() == expected);
+    int prev = -1;
+    for (int val : set) {
+        CHECK(prev < val);
+        prev = val;
+    }
+}
+
+// Erasing through iterator returns the next element, also when the key of the next node moves.
+template<class Balance>
+void test_erase_iterator() {
+    Set<int, 4, Balance> set;
+    for (int i = 0; i < 1000; ++i) {
+        set.insert(i * 7 % 1000);
+    }
+    for (auto it = set.begin(); it != set.end();) {
+        int val = *it;
+        if (val % 3 == 0) {
+            it = set.erase(it);
+        } else {
+            ++it;
+        }
+        CHECK(it == set.end() || *it == val + 1);
+    }
+    CHECK(set.size() == 666);
+    int expected = 1;
+    for (int val : set) {
+        CHECK(val == expected);
+        expected += expected % 3 == 1 ? 1 : 2;
+    }
+}
+
+// Batches of erases go by finger search through the combiner, and their results are all applied.
+void test_combining_erase() {
+    CombiningSet<int> set;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&set, t]() {
+            for (int i = t; i < 4000; i += 4) {
+                set.insert(i);
+            }
+            for (int i = t; i < 4000; i += 8) {
+                set.erase(i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(set.set().size() == 2000);
+    for (int i = 0; i < 4000; ++i) {
+        CHECK(set.contains(i) == (i % 8 >= 4));
+    }
+}
+
+// Writers on overlapping ranges: the set ends up as their successful inserts and erases say. Keys, which
+// writers never touch, are seen by every ordered walk, which readers make by lower_bound in the meantime.
+void test_concurrent_overlapping_writers() {
+    const int range = 4000;
+    const int writers = 4;
+    ConcurrentSet<int> set;
+    for (int k = 0; k < range; k += 10) {
+        set.insert(k);
+    }
+    std::vector<std::vector<int>> net(writers, std::vector<int>(range));
+    std::atomic<bool> done{false};
+    std::atomic<int> walks{0};
+    std::atomic<bool> walk_failed{false};
+    std::thread reader([&]() {
+        while (!done.load() || walks.load() == 0) {
+            int stable = 0;
+            int prev = -1;
+            for (int val; set.lower_bound(prev + 1, val); prev = val) {
+                if (val <= prev || val >= range) {
+                    walk_failed = true;
+                }
+                stable += val % 10 == 0;
+            }
+            if (stable != range / 10) {
+                walk_failed = true;
+            }
+            ++walks;
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < writers; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 rnd(t);
+            // Ranges of neighbouring writers overlap by half.
+            const int lo = t * range / (writers + 1);
+            const int width = 2 * range / (writers + 1);
+            for (int i = 0; i < 50000; ++i) {
+                int key = lo + int(rnd() % width);
+                if (key % 10 == 0) {
+                    set.contains(key);
+                } else if (rnd() % 2 == 0) {
+                    net[t][key] += set.insert(key);
+                } else {
+                    net[t][key] -= set.erase(key);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    done = true;
+    reader.join();
+    CHECK(!walk_failed && walks > 0);
+    size_t expected_size = 0;
+    for (int k = 0; k < range; ++k) {
+        int present = k % 10 == 0;
+        for (int t = 0; t < writers; ++t) {
+            present += net[t][k];
+        }
+        CHECK(present == 0 || present == 1);
+        CHECK(set.contains(k) == (present == 1));
+        expected_size += present;
+    }
+    CHECK(set.size() == expected_size);
+}
+
+// Snapshots keep their contents, while the set and other snapshots change, and outlive each other in any order.
+void test_persistent_snapshots() {
+    auto contents = [](const PersistentSet<int>& set) {
+        std::vector<int> keys;
+        for (int val : set) {
+            keys.push_back(val);
+        }
+        return keys;
+    };
+    PersistentSet<int> set{1, 2, 3};
+    PersistentSet<int> snapshot = set.snapshot();
+    set.insert(4);
+    set.erase(1);
+    PersistentSet<int> copy = snapshot;
+    copy.insert(0);
+    CHECK(contents(snapshot) == std::vector<int>({1, 2, 3}) && snapshot.size() == 3);
+    CHECK(contents(set) == std::vector<int>({2, 3, 4}) && contents(copy) == std::vector<int>({0, 1, 2, 3}));
+
+    std::mt19937 rnd(45);
+    std::vector<PersistentSet<int>> versions;
+    std::vector<std::vector<int>> expected;
+    std::vector<char> model(1000);
+    for (int val : set) {
+        model[val] = true;
+    }
+    for (int v = 0; v < 200; ++v) {
+        for (int i = 0; i < 20; ++i) {
+            int key = int(rnd() % model.size());
+            if (rnd() % 3 == 0) {
+                set.erase(key);
+                model[key] = false;
+            } else {
+                set.insert(key);
+                model[key] = true;
+            }
+        }
+        versions.push_back(set.snapshot());
+        expected.emplace_back();
+        for (int k = 0; k < int(model.size()); ++k) {
+            if (model[k]) {
+                expected.back().push_back(k);
+            }
+        }
+    }
+    // Versions are dropped in random order, and the remaining ones must not notice.
+    std::vector<size_t> order(versions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rnd);
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i % 20 == 0) {
+            for (size_t v = 0; v < versions.size(); ++v) {
+                CHECK(versions[v].empty() || contents(versions[v]) == expected[v]);
+            }
+        }
+        versions[order[i]] = PersistentSet<int>();
+    }
+    CHECK(contents(set) == expected.back() && contents(snapshot) == std::vector<int>({1, 2, 3}));
+}
+
+// Reader keeps its version intact, while the writer publishes new ones. Writer's updates add or drop pairs
+// {k, k + range} at once, so each version, that a reader sees, holds both keys of a pair or none.
+void test_rcu_readers_keep_version() {
+    const int range = 500;
+    RcuSet<int> set;
+    std::atomic<int> publishes{0};
+    std::atomic<bool> done{false};
+    std::atomic<int> spanned{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                RcuSet<int>::Reader reader(set);
+                std::vector<int> pinned;
+                for (int val : *reader) {
+                    pinned.push_back(val);
+                }
+                for (int val : pinned) {
+                    if (!reader->contains(val < range ? val + range : val - range)) {
+                        failed = true;
+                    }
+                }
+                // Reader waits for a few publishes and reads its version again.
+                int start = publishes.load();
+                for (int i = 0; i < 100 && publishes.load() < start + 3 && !done.load(); ++i) {
+                    std::this_thread::yield();
+                }
+                spanned += publishes.load() > start;
+                size_t k = 0;
+                for (int val : *reader) {
+                    if (k >= pinned.size() || pinned[k++] != val) {
+                        failed = true;
+                    }
+                }
+                if (k != pinned.size() || reader->size() != pinned.size()) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    std::mt19937 rnd(48);
+    for (int i = 0; i < 20000; ++i) {
+        int key = int(rnd() % range);
+        bool insert = rnd() % 2 == 0;
+        set.update([key, insert](PersistentSet<int>& version) {
+            if (insert) {
+                version.insert(key);
+                version.insert(key + range);
+            } else {
+                version.erase(key);
+                version.erase(key + range);
+            }
+        });
+        ++publishes;
+    }
+    done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    CHECK(!failed && spanned > 0);
+}
+
+// Key, which counts its comparisons.
+struct CountedKey {
+    int val;
+    static size_t comparisons;
+
+    bool operator<(const CountedKey& other) const {
+        ++comparisons;
+        return val < other.val;
+    }
+};
+
+size_t CountedKey::comparisons = 0;
+
+// Diff of versions matches difference of their contents, and of related versions skips shared subtrees.
+void test_persistent_diff() {
+    std::mt19937 rnd(46);
+    auto check_diff = [](const PersistentSet<int>& a, const PersistentSet<int>& b) {
+        std::vector<int> old_keys, new_keys, added, removed, expected_added, expected_removed;
+        for (int val : a) {
+            old_keys.push_back(val);
+        }
+        for (int val : b) {
+            new_keys.push_back(val);
+        }
+        diff(a, b, [&added](int val) { added.push_back(val); }, [&removed](int val) { removed.push_back(val); });
+        std::set_difference(new_keys.begin(), new_keys.end(), old_keys.begin(), old_keys.end(),
+                            std::back_inserter(expected_added));
+        std::set_difference(old_keys.begin(), old_keys.end(), new_keys.begin(), new_keys.end(),
+                            std::back_inserter(expected_removed));
+        CHECK(added == expected_added && removed == expected_removed);
+    };
+    PersistentSet<int> base;
+    for (int i = 0; i < 5000; ++i) {
+        base.insert(int(rnd() % 20000));
+    }
+    PersistentSet<int> related = base;
+    for (int i = 0; i < 100; ++i) {
+        int key = int(rnd() % 20000);
+        if (i % 2 == 0) {
+            related.insert(key);
+        } else {
+            related.erase(key);
+        }
+    }
+    check_diff(base, related);
+    check_diff(related, base);
+    check_diff(base, base.snapshot());
+    check_diff(base, PersistentSet<int>());
+    PersistentSet<int> unrelated;
+    for (int i = 0; i < 3000; ++i) {
+        unrelated.insert(int(rnd() % 20000));
+    }
+    check_diff(base, unrelated);
+    check_diff(unrelated, base);
+
+    PersistentSet<CountedKey> large;
+    for (int i = 0; i < (1 << 16); ++i) {
+        large.insert(CountedKey{2 * i});
+    }
+    PersistentSet<CountedKey> changed = large;
+    changed.insert(CountedKey{777});
+    changed.erase(CountedKey{5000});
+    int added = 0, removed = 0;
+    CountedKey::comparisons = 0;
+    diff(large, changed, [&added](const CountedKey& key) { added += key.val; },
+         [&removed](const CountedKey& key) { removed += key.val; });
+    CHECK(added == 777 && removed == 5000 && CountedKey::comparisons < 500);
+}
+
+int main() {
+    test_load_malformed();
+    test_load_merged_malformed<0>();
+    test_load_merged_malformed<8>();
+    test_mapped_corrupted_header();
+    test_integer_decrement<uint8_t>();
+    test_integer_decrement<uint16_t>();
+    test_integer_decrement<uint64_t>();
+    test_ordered_set_opt_in();
+    test_roaring_broken_runs();
+    test_interval_wide_runs();
+    test_interval_max_value<int>();
+    test_interval_max_value<int64_t>();
+    test_interval_max_value<uint8_t>();
+    test_cache_erase_compact();
+    test_lazy_erase_all_deleted();
+    test_background_teardown_drain();
+    test_write_buffer_hinted_insert();
+    test_sharded_concurrent_insert();
+    test_sharded_concurrent_resplit();
+    test_erase_iterator<AvlBalance>();
+    test_erase_iterator<RedBlackBalance>();
+    test_erase_iterator<WavlBalance>();
+    test_erase_iterator<SplayBalance>();
+    test_combining_erase();
+    test_concurrent_overlapping_writers();
+    test_persistent_snapshots();
+    test_persistent_diff();
+    test_rcu_readers_keep_version();
+    std::puts("ok");
+}